@@ -1,4 +1,10 @@
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+#include <random>
 #include <sstream>
+#include <stdexcept>
 #include "AsciiLoader.hpp"
 using namespace mcl;
 //using namespace juce;
@@ -6,60 +12,215 @@ using namespace mcl;
 
 
 
+// =============================================================================
+static bool isBlank (char c)
+{
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+static const char* findEndOfLine (const char* c, const char* end)
+{
+    auto eol = static_cast<const char*> (std::memchr (c, '\n', end - c));
+    return eol ? eol : end;
+}
+
+static const char* startOfNextLine (const char* c, const char* end)
+{
+    auto eol = findEndOfLine (c, end);
+    return eol == end ? end : eol + 1;
+}
+
+static const char* skipBlanks (const char* c, const char* eol)
+{
+    while (c != eol && isBlank (*c))
+        ++c;
+    return c;
+}
+
+static const char* skipToken (const char* c, const char* eol)
+{
+    while (c != eol && ! isBlank (*c))
+        ++c;
+    return c;
+}
+
+static unsigned long countTokens (const char* c, const char* eol)
+{
+    unsigned long n = 0;
+
+    while ((c = skipBlanks (c, eol)) != eol)
+    {
+        c = skipToken (c, eol);
+        ++n;
+    }
+    return n;
+}
+
+/**
+ Parse the next whitespace-delimited token on the line as a double, and advance
+ c past it. Returns false if the line has no more tokens or if the token is not
+ a number. The token is copied to a terminated buffer because the source may be
+ a memory-mapped file, where strtod is not guaranteed to find a terminator.
+ */
+static bool parseNextNumber (const char*& c, const char* eol, double& value)
+{
+    char buffer[64];
+    auto start = skipBlanks (c, eol);
+    auto stop = skipToken (start, eol);
+    auto size = std::size_t (stop - start);
+
+    if (size == 0 || size >= sizeof (buffer))
+        return false;
+
+    std::memcpy (buffer, start, size);
+    buffer[size] = '\0';
+
+    char* parsed = nullptr;
+    value = std::strtod (buffer, &parsed);
+    c = stop;
+    return parsed == buffer + size;
+}
+
+/**
+ Read the column names from a header line, omitting its leading '#' token.
+ */
+static std::vector<std::string> parseHeader (const char* line, const char* eol)
+{
+    std::vector<std::string> names;
+
+    for (auto t = skipBlanks (skipToken (line, eol), eol); t != eol; t = skipBlanks (t, eol))
+    {
+        auto s = skipToken (t, eol);
+        names.emplace_back (t, s);
+        t = s;
+    }
+    return names;
+}
+
+static std::vector<std::string> defaultColumnNames (unsigned long numColumns)
+{
+    std::vector<std::string> names;
+
+    for (int i = 0; i < numColumns; ++i)
+    {
+        names.push_back ("Col " + std::to_string(i));
+    }
+    return names;
+}
+
+
+
+
 // =============================================================================
 AsciiLoader::AsciiLoader (std::istream& stream)
 {
-    int fileLine = 0;
+    auto text = std::string {
+        std::istreambuf_iterator<char> (stream),
+        std::istreambuf_iterator<char>() };
+
+    parse (text.data(), text.data() + text.size());
+}
+
+AsciiLoader::AsciiLoader (const char* begin, const char* end, bool completeLinesOnly)
+: completeLinesOnly (completeLinesOnly)
+{
+    parse (begin, end);
+}
+
+AsciiLoader::AsciiLoader (const char* begin, const char* end, const std::vector<std::string>& columnNames)
+: numColumns (columnNames.size())
+, names (columnNames)
+, completeLinesOnly (true)
+, headerKnown (true)
+{
+    parse (begin, end);
+}
+
+void AsciiLoader::parse (const char* begin, const char* end)
+{
+    unsigned long rowsInSource = 0;
 
-    while (stream)
+    if (completeLinesOnly)
     {
-        std::string line;
-        std::getline (stream, line);
-        std::istringstream iss (line);
-        fileLine += 1;
+        while (end != begin && end[-1] != '\n')
+            --end;
+    }
+    bytesParsed = end - begin;
+
+    /*
+     First pass: read the header and count the data rows, so that each column
+     can be allocated exactly once.
+     */
+    for (auto c = begin; c < end; c = startOfNextLine (c, end))
+    {
+        auto eol = findEndOfLine (c, end);
+        auto line = skipBlanks (c, eol);
 
-        if (line[0] == '#' && data.empty())
+        if (line == eol)
+        {
+            continue;
+        }
+        else if (*line == '#' && rowsInSource == 0 && ! headerKnown)
         {
             /*
-            * The first line is header information.
+            * The last comment line before any data is header information.
             */
-            names = std::vector<std::string> {
-                std::istream_iterator<std::string>(iss),
-                std::istream_iterator<std::string>() };
-
-            names.erase (names.begin());
+            names = parseHeader (line, eol);
             numColumns = names.size();
         }
-        else if (line[0] != '#')
+        else if (*line != '#')
         {
-            std::vector<double> row {
-                std::istream_iterator<double>(iss),
-                std::istream_iterator<double>() };
-
-            if (names.empty() && data.empty())
+            if (names.empty() && rowsInSource == 0)
             {
-                numColumns = row.size();
+                numColumns = countTokens (line, eol);
             }
+            rowsInSource += 1;
+        }
+    }
 
-            if (names.empty())
-            {
-                for (int i = 0; i < numColumns; ++i)
-                {
-                    names.push_back ("Col " + std::to_string(i));
-                }
-            }
+    if (names.empty())
+    {
+        names = defaultColumnNames (numColumns);
+    }
 
-            if (row.size() == numColumns)
-            {
-                data.insert (data.end(), row.begin(), row.end());
-                numRows += 1;
-            }
-            else if (! row.empty())
-            {
-                status = "Missing data on line " + std::to_string (fileLine);
-            }
+    for (int j = 0; j < numColumns; ++j)
+    {
+        columns.emplace_back (int (rowsInSource));
+    }
+
+    /*
+     Second pass: tokenize each data row directly into the column buffers.
+     */
+    int fileLine = 0;
+
+    for (auto c = begin; c < end && numRows < rowsInSource; c = startOfNextLine (c, end))
+    {
+        auto eol = findEndOfLine (c, end);
+        auto line = skipBlanks (c, eol);
+        fileLine += 1;
+
+        if (line == eol || *line == '#')
+        {
+            continue;
         }
-    };
+
+        unsigned long j = 0;
+        double value;
+
+        while (j < numColumns && parseNextNumber (line, eol, value))
+        {
+            columns[j](int (numRows)) = value;
+            ++j;
+        }
+
+        if (j != numColumns || skipBlanks (line, eol) != eol)
+        {
+            errorLine = fileLine;
+            status = "Missing data on line " + std::to_string (fileLine);
+            break;
+        }
+        numRows += 1;
+    }
 }
 
 unsigned long AsciiLoader::getNumColumns() const
@@ -72,15 +233,9 @@ unsigned long AsciiLoader::getNumRows() const
     return numRows;
 }
 
-std::vector<double> AsciiLoader::getColumnData (int j) const
+nd::ndarray<double, 1> AsciiLoader::takeColumnData (int j)
 {
-    std::vector<double> column;
-
-    for (int i = 0; i < numRows; ++i)
-    {
-        column.push_back (data[i * numColumns + j]);
-    }
-    return column;
+    return std::move (columns.at (j));
 }
 
 std::vector<double> AsciiLoader::getRowData (int i) const
@@ -89,7 +244,7 @@ std::vector<double> AsciiLoader::getRowData (int i) const
 
     for (int j = 0; j < numColumns; ++j)
     {
-        row.push_back (data[i * numColumns + j]);
+        row.push_back (columns[j](i));
     }
     return row;
 }
@@ -99,7 +254,185 @@ std::string AsciiLoader::getColumnName (int index) const
     return names.at (index);
 }
 
+const std::vector<std::string>& AsciiLoader::getColumnNames() const
+{
+    return names;
+}
+
 std::string AsciiLoader::getStatusMessage() const
 {
     return status;
 }
+
+unsigned long AsciiLoader::getErrorLine() const
+{
+    return errorLine;
+}
+
+std::size_t AsciiLoader::getNumBytesParsed() const
+{
+    return bytesParsed;
+}
+
+
+
+
+// =============================================================================
+AsciiIndex::AsciiIndex (const char* begin, const char* end) : AsciiIndex (begin, end, Selection())
+{
+}
+
+AsciiIndex::AsciiIndex (const char* begin, const char* end, Selection selection) : begin (begin), end (end)
+{
+    auto random = std::mt19937_64 (selection.seed);
+    unsigned long rowNumber = 0;
+    unsigned long numCandidates = 0;
+    unsigned long fileLine = 0;
+
+    /*
+     The lines are found with memchr, and the rows in the selection have their
+     fields counted but not converted, so rows outside it cost no more than the
+     newline scan. A random sample is drawn by reservoir sampling over the
+     candidate rows.
+     */
+    for (auto c = begin; c < end && rowNumber < selection.last; c = startOfNextLine (c, end))
+    {
+        auto eol = findEndOfLine (c, end);
+        auto line = skipBlanks (c, eol);
+        fileLine += 1;
+
+        if (line == eol)
+        {
+            continue;
+        }
+        else if (*line == '#' && rowNumber == 0)
+        {
+            names = parseHeader (line, eol);
+            numColumns = names.size();
+        }
+        else if (*line != '#')
+        {
+            if (names.empty() && rowNumber == 0)
+            {
+                numColumns = countTokens (line, eol);
+            }
+            if (rowNumber >= selection.first && (rowNumber - selection.first) % selection.every == 0)
+            {
+                if (countTokens (line, eol) != numColumns)
+                {
+                    errorLine = fileLine;
+                    status = "Missing data on line " + std::to_string (fileLine);
+                    break;
+                }
+                if (selection.sample == 0 || rows.size() < selection.sample)
+                {
+                    rows.push_back (line);
+                }
+                else
+                {
+                    auto k = std::uniform_int_distribution<unsigned long> (0, numCandidates) (random);
+
+                    if (k < selection.sample)
+                        rows[k] = line;
+                }
+                numCandidates += 1;
+            }
+            rowNumber += 1;
+        }
+    }
+
+    if (selection.sample > 0)
+    {
+        std::sort (rows.begin(), rows.end());
+    }
+
+    if (names.empty())
+    {
+        names = defaultColumnNames (numColumns);
+    }
+}
+
+unsigned long AsciiIndex::getNumColumns() const
+{
+    return numColumns;
+}
+
+unsigned long AsciiIndex::getNumRows() const
+{
+    return rows.size();
+}
+
+std::string AsciiIndex::getColumnName (int index) const
+{
+    return names.at (index);
+}
+
+const std::vector<std::string>& AsciiIndex::getColumnNames() const
+{
+    return names;
+}
+
+std::string AsciiIndex::getStatusMessage() const
+{
+    return status;
+}
+
+unsigned long AsciiIndex::getErrorLine() const
+{
+    return errorLine;
+}
+
+nd::ndarray<double, 1> AsciiIndex::parseColumn (int index) const
+{
+    auto column = nd::ndarray<double, 1> (int (rows.size()));
+
+    for (int i = 0; i < rows.size(); ++i)
+    {
+        auto c = rows[i];
+        auto eol = findEndOfLine (c, end);
+        double value;
+
+        for (int j = 0; j < index && c != eol; ++j)
+        {
+            c = skipToken (skipBlanks (c, eol), eol);
+        }
+        if (! parseNextNumber (c, eol, value))
+        {
+            throw std::runtime_error ("Bad data on line " + std::to_string (lineNumberOf (rows[i])));
+        }
+        column(i) = value;
+    }
+    return column;
+}
+
+std::string AsciiIndex::parseRows (const std::vector<double*>& targets) const
+{
+    for (int i = 0; i < rows.size(); ++i)
+    {
+        auto c = rows[i];
+        auto eol = findEndOfLine (c, end);
+        unsigned long j = 0;
+        double value;
+
+        while (j < numColumns && parseNextNumber (c, eol, value))
+        {
+            targets[j][i] = value;
+            ++j;
+        }
+
+        if (j != numColumns || skipBlanks (c, eol) != eol)
+        {
+            return "Missing data on line " + std::to_string (lineNumberOf (rows[i]));
+        }
+    }
+    return std::string();
+}
+
+/**
+ Return the line number of a row, by counting the lines before it. This is only
+ done to report an error, so the index does not store line numbers.
+ */
+unsigned long AsciiIndex::lineNumberOf (const char* row) const
+{
+    return (unsigned long) std::count (begin, row, '\n') + 1;
+}
@@ -1,27 +1,147 @@
 #pragma once
+#include <climits>
 #include <vector>
 #include <string>
+#include "3rdParty/ndarray/ndarray.hpp"
 
-namespace mcl { class AsciiLoader; }
+namespace mcl { class AsciiLoader; class AsciiIndex; }
 
 
 
 
 // =============================================================================
+/**
+Parser for whitespace-separated columns of numbers. An optional header line
+starting with '#' names the columns. The data is stored column-major: the
+source is scanned once to count the data rows, and each column is then
+allocated at its final size and filled in place as the rows are tokenized.
+*/
 class mcl::AsciiLoader
 {
 public:
     AsciiLoader (std::istream& stream);
+
+    /** Parse the given region of text. If completeLinesOnly is true, a final
+        line that is not terminated by a newline is left unparsed, so that a
+        row which is still being written is not read in part.
+     */
+    AsciiLoader (const char* begin, const char* end, bool completeLinesOnly=false);
+
+    /** Parse rows that continue a source whose header was already read, for
+        example the bytes appended to a file since it was last loaded. The
+        columns are given by columnNames, comment lines are skipped, and only
+        complete lines are parsed.
+     */
+    AsciiLoader (const char* begin, const char* end, const std::vector<std::string>& columnNames);
+
     unsigned long getNumColumns() const;
     unsigned long getNumRows() const;
-    std::vector<double> getColumnData (int index) const;
+
+    /** Move the data of the given column out of the loader. The loader's copy
+        of the column is left empty, so this should be called at most once per
+        column.
+     */
+    nd::ndarray<double, 1> takeColumnData (int index);
     std::vector<double> getRowData (int index) const;
     std::string getColumnName (int index) const;
+    const std::vector<std::string>& getColumnNames() const;
     std::string getStatusMessage() const;
+
+    /** Return the line of the source on which parsing stopped because of
+        missing or bad data, or zero if there was no error.
+     */
+    unsigned long getErrorLine() const;
+
+    /** Return the number of bytes of the source that were parsed. This is less
+        than the source size if trailing partial lines were skipped.
+     */
+    std::size_t getNumBytesParsed() const;
 private:
+    void parse (const char* begin, const char* end);
     unsigned long numColumns = 0;
     unsigned long numRows = 0;
-    std::vector<double> data;
+    std::vector<nd::ndarray<double, 1>> columns;
     std::vector<std::string> names;
     std::string status;
+    unsigned long errorLine = 0;
+    std::size_t bytesParsed = 0;
+    bool completeLinesOnly = false;
+    bool headerKnown = false;
+};
+
+
+
+
+// =============================================================================
+/**
+Index of the data rows in a region of text with the same layout as is read by
+AsciiLoader. The source is scanned once for the header and the start of each
+data row, and individual columns are then tokenized on request, so a column
+that is never used is never parsed. The number of fields in each indexed row is
+checked as it is scanned, so rows with missing data are reported as they would
+be by AsciiLoader. The text must remain valid for as long as the index is used.
+*/
+class mcl::AsciiIndex
+{
+public:
+    /**
+     A subset of the data rows to index. Rows are numbered from zero, in the
+     order of the data rows in the text. The rows in [first, last) are taken,
+     thinned to every one in every, and if sample is non-zero, a uniformly
+     random sample of that many of those rows is kept, in source order.
+     */
+    struct Selection
+    {
+        unsigned long first = 0;
+        unsigned long last = ULONG_MAX;
+        unsigned long every = 1;
+        unsigned long sample = 0;
+        unsigned long seed = 0;
+        bool isEverything() const { return first == 0 && last == ULONG_MAX && every == 1 && sample == 0; }
+    };
+
+    AsciiIndex (const char* begin, const char* end);
+
+    /** Index only the selected rows of the given text. Scanning stops after
+        the last row of the selection.
+     */
+    AsciiIndex (const char* begin, const char* end, Selection selection);
+
+    unsigned long getNumColumns() const;
+    unsigned long getNumRows() const;
+    std::string getColumnName (int index) const;
+    const std::vector<std::string>& getColumnNames() const;
+
+    /** Return a message naming the first indexed line whose number of fields
+        differs from the number of columns, or an empty string if there is
+        none. Scanning stops at that line.
+     */
+    std::string getStatusMessage() const;
+
+    /** Return the line of the source that has missing data, or zero if there
+        was no error.
+     */
+    unsigned long getErrorLine() const;
+
+    /** Parse the given column. Only the tokens up to the requested field are
+        read from each row. Throws std::runtime_error naming the line if a
+        field is not a number.
+     */
+    nd::ndarray<double, 1> parseColumn (int index) const;
+
+    /** Parse every row into the given column buffers, which must each have
+        room for getNumRows() values. Each row is tokenized once. Returns an
+        empty string on success, or a message naming the first line that has
+        missing or bad data.
+     */
+    std::string parseRows (const std::vector<double*>& targets) const;
+private:
+    unsigned long lineNumberOf (const char* row) const;
+    const char* begin = nullptr;
+    const char* end = nullptr;
+    std::string status;
+    unsigned long errorLine = 0;
+    unsigned long numColumns = 0;
+    std::vector<const char*> rows;
+    std::vector<std::string> names;
 };
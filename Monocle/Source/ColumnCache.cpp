@@ -0,0 +1,213 @@
+#include "ColumnCache.hpp"
+#define SIDECAR_MAGIC "MCLCOLS\0"
+#define SIDECAR_EXTENSION ".mclcache"
+using namespace mcl;
+
+
+
+
+// ============================================================================
+static const uint32 byteOrderMark = 0x01020304;
+static const uint32 formatVersion = 1;
+static const int64 blockAlignment = 64;
+
+static File& fallbackDirectory()
+{
+    static File directory = File::getSpecialLocation (File::tempDirectory).getChildFile ("Monocle");
+    return directory;
+}
+
+static int64 alignedSize (int64 size)
+{
+    return (size + blockAlignment - 1) / blockAlignment * blockAlignment;
+}
+
+template<typename T>
+static void writeRaw (OutputStream& out, const T& value)
+{
+    out.write (&value, sizeof (T));
+}
+
+static void writePadding (OutputStream& out)
+{
+    out.writeRepeatedByte (0, size_t (alignedSize (out.getPosition()) - out.getPosition()));
+}
+
+
+
+
+// ============================================================================
+/**
+ Reads values in sequence from a mapped sidecar. Reads past the end of the data
+ fail, rather than overrunning, so that a truncated sidecar is rejected.
+ */
+class SidecarReader
+{
+public:
+    SidecarReader (const char* data, int64 size) : data (data), size (size) {}
+
+    template<typename T>
+    bool read (T& value)
+    {
+        if (position + int64 (sizeof (T)) > size)
+            return false;
+
+        std::memcpy (&value, data + position, sizeof (T));
+        position += sizeof (T);
+        return true;
+    }
+
+    bool read (std::string& value)
+    {
+        uint64 length;
+
+        if (! read (length) || int64 (length) > size - position)
+            return false;
+
+        value.assign (data + position, length);
+        position += length;
+        return true;
+    }
+
+    int64 getPosition() const { return position; }
+
+private:
+    const char* data;
+    int64 size;
+    int64 position = 0;
+};
+
+
+
+
+// ============================================================================
+void ColumnCache::setFallbackDirectory (const File& directory)
+{
+    fallbackDirectory() = directory;
+}
+
+bool ColumnCache::read (const File& source, const SourceVersion& version, Object::Dict& columns)
+{
+    for (const auto& file : { getSiblingFile (source), getFallbackFile (source) })
+    {
+        if (! file.existsAsFile())
+            continue;
+
+        auto mapped = std::make_shared<MemoryMappedFile> (file, MemoryMappedFile::readOnly);
+        auto data = static_cast<const char*> (mapped->getData());
+        auto size = int64 (mapped->getSize());
+
+        if (data == nullptr)
+            continue;
+
+        char magic[8];
+        uint32 bom, format;
+        uint64 numRows, numColumns;
+        SourceVersion v;
+        SidecarReader reader (data, size);
+
+        if (! (reader.read (magic) && std::memcmp (magic, SIDECAR_MAGIC, 8) == 0
+               && reader.read (bom) && bom == byteOrderMark
+               && reader.read (format) && format == formatVersion
+               && reader.read (v.size) && v.size == version.size
+               && reader.read (v.modified) && v.modified == version.modified
+               && reader.read (v.hash) && v.hash == version.hash
+               && reader.read (numRows) && numRows <= uint64 (size) / sizeof (double)
+               && reader.read (numColumns) && numColumns <= uint64 (size)))
+            continue;
+
+        auto names = std::vector<std::string> (numColumns);
+        auto namesAreValid = true;
+
+        for (auto& name : names)
+            namesAreValid = namesAreValid && reader.read (name);
+
+        auto offset = alignedSize (reader.getPosition());
+        auto blockSize = alignedSize (numRows * sizeof (double));
+
+        if (! namesAreValid || offset > size || (blockSize > 0 && int64 (numColumns) > (size - offset) / blockSize))
+            continue;
+
+        columns.clear();
+
+        for (uint64 n = 0; n < numColumns; ++n)
+        {
+            auto block = reinterpret_cast<const double*> (data + offset + n * blockSize);
+            columns[names[n]] = Object::data (std::make_shared<ArrayDouble1> (mapped, block, numRows));
+        }
+        return true;
+    }
+    return false;
+}
+
+bool ColumnCache::write (const File& source,
+                         const SourceVersion& version,
+                         const std::vector<std::string>& names,
+                         const std::vector<std::shared_ptr<ArrayDouble1>>& columns)
+{
+    jassert (names.size() == columns.size());
+
+    auto numRows = uint64 (columns.empty() ? 0 : columns.front()->size());
+
+    for (const auto& column : columns)
+        if (column->size() != numRows)
+            return false;
+
+    for (const auto& target : { getSiblingFile (source), getFallbackFile (source) })
+    {
+        if (! target.getParentDirectory().createDirectory() || ! target.getParentDirectory().hasWriteAccess())
+            continue;
+
+        /*
+         The sidecar is written to a temporary file that replaces the target
+         only once it is complete, so a sidecar that is currently mapped by
+         another load remains intact.
+         */
+        TemporaryFile temp (target);
+        {
+            FileOutputStream out (temp.getFile());
+
+            if (out.failedToOpen())
+                continue;
+
+            out.write (SIDECAR_MAGIC, 8);
+            writeRaw (out, byteOrderMark);
+            writeRaw (out, formatVersion);
+            writeRaw (out, version.size);
+            writeRaw (out, version.modified);
+            writeRaw (out, version.hash);
+            writeRaw (out, numRows);
+            writeRaw (out, uint64 (columns.size()));
+
+            for (const auto& name : names)
+            {
+                writeRaw (out, uint64 (name.size()));
+                out.write (name.data(), name.size());
+            }
+            writePadding (out);
+
+            for (const auto& column : columns)
+            {
+                out.write (column->data(), numRows * sizeof (double));
+                writePadding (out);
+            }
+            out.flush();
+
+            if (out.getStatus().failed())
+                continue;
+        }
+        if (temp.overwriteTargetFileWithTemporary())
+            return true;
+    }
+    return false;
+}
+
+File ColumnCache::getSiblingFile (const File& source)
+{
+    return source.getSiblingFile (source.getFileName() + SIDECAR_EXTENSION);
+}
+
+File ColumnCache::getFallbackFile (const File& source)
+{
+    return fallbackDirectory().getChildFile (String::toHexString (source.getFullPathName().hashCode64()) + SIDECAR_EXTENSION);
+}
@@ -0,0 +1,50 @@
+#pragma once
+#include "JuceHeader.h"
+#include "NumericData.hpp"
+#include "Kernel/Object.hpp"
+
+
+
+
+// ============================================================================
+/**
+Binary sidecar files holding the parsed columns of a text file, so that the
+text is parsed only once per version of the file. A sidecar starts with a
+header identifying the version of its source (size, modification time, and a
+content hash), followed by the column names and a 64-byte aligned block of
+float64 values for each column. A valid sidecar is memory-mapped, and the
+columns returned from it reference the mapped data without copying.
+*/
+class ColumnCache
+{
+public:
+    struct SourceVersion
+    {
+        int64 size = 0;
+        int64 modified = 0;
+        uint64 hash = 0;
+    };
+
+    /** Set the directory that sidecars are written to when the directory of
+        their source is not writable. By default this is a folder in the
+        system's temporary directory.
+     */
+    static void setFallbackDirectory (const File& directory);
+
+    /** Load the columns from a sidecar of the given source, if one exists and
+        was written for the given version of it. Returns false otherwise.
+     */
+    static bool read (const File& source, const SourceVersion& version, mcl::Object::Dict& columns);
+
+    /** Write a sidecar for the given version of the source. Returns false if
+        it could not be written.
+     */
+    static bool write (const File& source,
+                       const SourceVersion& version,
+                       const std::vector<std::string>& names,
+                       const std::vector<std::shared_ptr<ArrayDouble1>>& columns);
+
+private:
+    static File getSiblingFile (const File& source);
+    static File getFallbackFile (const File& source);
+};
@@ -0,0 +1,456 @@
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cmath>
+#include <deque>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include "CsvLoader.hpp"
+#include "NumericData.hpp"
+using namespace mcl;
+
+
+
+
+// =============================================================================
+struct Field
+{
+    const char* begin;
+    const char* end;
+    bool quoted;
+};
+
+/**
+ Return the first occurrence of the delimiter or a newline at or after c. The
+ search tests eight bytes at a time using the has-zero-byte bit trick on the
+ word XOR'd with each target byte, and only falls back to a byte loop within
+ the word that contains a match.
+ */
+static const char* findDelimiterOrNewline (const char* c, const char* end, char delimiter)
+{
+    const std::uint64_t ones = 0x0101010101010101ull;
+    const std::uint64_t highs = 0x8080808080808080ull;
+    const std::uint64_t d = ones * std::uint8_t (delimiter);
+    const std::uint64_t n = ones * std::uint8_t ('\n');
+
+    while (end - c >= 8)
+    {
+        std::uint64_t word;
+        std::memcpy (&word, c, 8);
+
+        auto x = word ^ d;
+        auto y = word ^ n;
+
+        if (((x - ones) & ~x & highs) | ((y - ones) & ~y & highs))
+            break;
+
+        c += 8;
+    }
+    while (c != end && *c != delimiter && *c != '\n')
+        ++c;
+
+    return c;
+}
+
+/**
+ Read the field starting at c, and return the position after the delimiter or
+ newline that ends it. An unquoted field refers to the source; a quoted field
+ is unescaped into scratch, and may contain delimiters and newlines.
+ */
+static const char* readField (const char* c, const char* end, const CsvLoader::Options& options, Field& field, std::string& scratch, bool& endOfRow)
+{
+    if (c != end && *c == options.quote)
+    {
+        scratch.clear();
+        ++c;
+
+        while (c != end)
+        {
+            auto q = static_cast<const char*> (std::memchr (c, options.quote, end - c));
+
+            if (q == nullptr)
+            {
+                scratch.append (c, end);
+                c = end;
+                break;
+            }
+            scratch.append (c, q);
+            c = q + 1;
+
+            if (c != end && *c == options.quote)
+            {
+                scratch.push_back (options.quote);
+                ++c;
+            }
+            else break;
+        }
+        field = { scratch.data(), scratch.data() + scratch.size(), true };
+        c = findDelimiterOrNewline (c, end, options.delimiter);
+    }
+    else
+    {
+        auto stop = findDelimiterOrNewline (c, end, options.delimiter);
+        field = { c, stop, false };
+        c = stop;
+    }
+
+    if (c == end)
+    {
+        endOfRow = true;
+        return end;
+    }
+    endOfRow = *c == '\n';
+    return c + 1;
+}
+
+static Field trimmed (Field field)
+{
+    auto isSpace = [] (char c) { return c == ' ' || c == '\t' || c == '\r'; };
+
+    while (field.begin != field.end && isSpace (*field.begin))
+        ++field.begin;
+    while (field.end != field.begin && isSpace (field.end[-1]))
+        --field.end;
+
+    return field;
+}
+
+static bool isEmpty (const Field& field)
+{
+    return field.begin == field.end;
+}
+
+/**
+ Copy a field to a terminated buffer for strtod and strtoll, since the source
+ may be a memory-mapped file. Fields too long to be a number are rejected.
+ */
+static bool copyToBuffer (const Field& field, char* buffer, std::size_t bufferSize)
+{
+    auto size = std::size_t (field.end - field.begin);
+
+    if (size == 0 || size >= bufferSize)
+        return false;
+
+    std::memcpy (buffer, field.begin, size);
+    buffer[size] = '\0';
+    return true;
+}
+
+static bool parseInt (const Field& field, std::int64_t& value)
+{
+    char buffer[64];
+    char* parsed = nullptr;
+
+    if (! copyToBuffer (field, buffer, sizeof (buffer)))
+        return false;
+
+    errno = 0;
+    value = std::strtoll (buffer, &parsed, 10);
+    return errno == 0 && parsed == buffer + (field.end - field.begin);
+}
+
+static bool parseDouble (const Field& field, double& value)
+{
+    char buffer[64];
+    char* parsed = nullptr;
+
+    if (! copyToBuffer (field, buffer, sizeof (buffer)))
+        return false;
+
+    value = std::strtod (buffer, &parsed);
+    return parsed == buffer + (field.end - field.begin);
+}
+
+static bool parseBool (const Field& field, bool& value)
+{
+    auto equals = [&field] (const char* word)
+    {
+        auto size = std::strlen (word);
+
+        if (std::size_t (field.end - field.begin) != size)
+            return false;
+
+        for (std::size_t i = 0; i < size; ++i)
+            if (std::tolower ((unsigned char) field.begin[i]) != word[i])
+                return false;
+
+        return true;
+    };
+
+    if (equals ("true"))  { value = true;  return true; }
+    if (equals ("false")) { value = false; return true; }
+    return false;
+}
+
+static char detectDelimiter (const char* begin, const char* end)
+{
+    auto eol = static_cast<const char*> (std::memchr (begin, '\n', end - begin));
+    auto best = ',';
+    auto bestCount = 0l;
+
+    for (auto candidate : { ',', '\t', ';', '|' })
+    {
+        auto count = long (std::count (begin, eol ? eol : end, candidate));
+
+        if (count > bestCount)
+        {
+            best = candidate;
+            bestCount = count;
+        }
+    }
+    return best;
+}
+
+
+
+
+// =============================================================================
+CsvLoader::CsvLoader (const char* begin, const char* end, Options options) : options (options)
+{
+    if (this->options.delimiter == 0)
+    {
+        this->options.delimiter = detectDelimiter (begin, end);
+    }
+    inferTypes (begin, end);
+
+    if (status.empty())
+    {
+        fillColumns (begin, end);
+    }
+}
+
+template<typename Callback>
+bool CsvLoader::forEachRow (const char* begin, const char* end, Callback callback)
+{
+    auto fields = std::vector<Field>();
+    auto scratch = std::deque<std::string>(); // elements stay in place as it grows
+    unsigned long line = 1;
+
+    for (auto c = begin; c < end; )
+    {
+        auto rowStart = c;
+        auto endOfRow = false;
+        fields.clear();
+
+        while (! endOfRow)
+        {
+            if (scratch.size() <= fields.size())
+                scratch.emplace_back();
+
+            Field field;
+            c = readField (c, end, options, field, scratch[fields.size()], endOfRow);
+            fields.push_back (field);
+        }
+
+        auto isBlankLine = fields.size() == 1 && ! fields[0].quoted && isEmpty (trimmed (fields[0]));
+
+        if (! isBlankLine && ! callback (fields, line))
+            return false;
+
+        line += std::count (rowStart, c, '\n');
+    }
+    return true;
+}
+
+void CsvLoader::inferTypes (const char* begin, const char* end)
+{
+    auto canBeBool   = std::vector<bool>();
+    auto canBeInt    = std::vector<bool>();
+    auto canBeDouble = std::vector<bool>();
+    auto isFirstRow = true;
+
+    forEachRow (begin, end, [&] (const std::vector<Field>& fields, unsigned long line)
+    {
+        if (isFirstRow)
+        {
+            isFirstRow = false;
+            columns.resize (fields.size());
+            canBeBool  .assign (fields.size(), true);
+            canBeInt   .assign (fields.size(), true);
+            canBeDouble.assign (fields.size(), true);
+
+            auto looksLikeHeader = std::none_of (fields.begin(), fields.end(), [] (const Field& field)
+            {
+                auto f = trimmed (field);
+                std::int64_t i;
+                double d;
+                bool b;
+                return isEmpty (f) || parseInt (f, i) || parseDouble (f, d) || parseBool (f, b);
+            });
+            hasHeaderRow = options.header == 1 || (options.header == -1 && looksLikeHeader);
+
+            for (int j = 0; j < fields.size(); ++j)
+            {
+                auto name = fields[j].quoted ? fields[j] : trimmed (fields[j]);
+                names.push_back (hasHeaderRow ? std::string (name.begin, name.end) : "Col " + std::to_string (j));
+            }
+            if (hasHeaderRow)
+            {
+                return true;
+            }
+        }
+
+        if (fields.size() != columns.size())
+        {
+            status = "line " + std::to_string (line) + ": expected "
+            + std::to_string (columns.size()) + " fields, found "
+            + std::to_string (fields.size());
+            return false;
+        }
+
+        for (int j = 0; j < fields.size(); ++j)
+        {
+            if (! canBeDouble[j])
+                continue;
+
+            auto f = trimmed (fields[j]);
+            std::int64_t i;
+            double d;
+            bool b;
+
+            if (isEmpty (f))
+            {
+                canBeBool[j] = false;
+                canBeInt[j] = false;
+                continue;
+            }
+            if (canBeBool[j] && ! parseBool (f, b))
+                canBeBool[j] = false;
+
+            if (canBeInt[j] && ! parseInt (f, i))
+                canBeInt[j] = false;
+
+            if (! canBeBool[j] && ! canBeInt[j] && ! parseDouble (f, d))
+                canBeDouble[j] = false;
+        }
+        numRows += 1;
+        return true;
+    });
+
+    for (int j = 0; j < columns.size(); ++j)
+    {
+        if (numRows == 0)         columns[j].type = ColumnType::float64;
+        else if (canBeBool[j])    columns[j].type = ColumnType::boolean;
+        else if (canBeInt[j])     columns[j].type = ColumnType::int64;
+        else if (canBeDouble[j])  columns[j].type = ColumnType::float64;
+        else                      columns[j].type = ColumnType::string;
+    }
+}
+
+void CsvLoader::fillColumns (const char* begin, const char* end)
+{
+    auto skipRow = hasHeaderRow;
+
+    for (auto& column : columns)
+    {
+        switch (column.type)
+        {
+            case ColumnType::boolean: column.booleans.reserve (numRows); break;
+            case ColumnType::int64:   column.integers.reserve (numRows); break;
+            case ColumnType::float64: column.doubles.become (nd::ndarray<double, 1> (int (numRows))); break;
+            case ColumnType::string:  column.codes   .reserve (numRows); break;
+        }
+    }
+
+    auto row = 0;
+
+    forEachRow (begin, end, [&] (const std::vector<Field>& fields, unsigned long)
+    {
+        if (skipRow)
+        {
+            skipRow = false;
+            return true;
+        }
+
+        for (int j = 0; j < fields.size(); ++j)
+        {
+            auto& column = columns[j];
+            auto f = trimmed (fields[j]);
+
+            switch (column.type)
+            {
+                case ColumnType::boolean:
+                {
+                    bool b = false;
+                    parseBool (f, b);
+                    column.booleans.push_back (b);
+                    break;
+                }
+                case ColumnType::int64:
+                {
+                    std::int64_t i = 0;
+                    parseInt (f, i);
+                    column.integers.push_back (i);
+                    break;
+                }
+                case ColumnType::float64:
+                {
+                    double d = std::numeric_limits<double>::quiet_NaN();
+
+                    if (! isEmpty (f))
+                        parseDouble (f, d);
+
+                    column.doubles (row) = d;
+                    break;
+                }
+                case ColumnType::string:
+                {
+                    auto text = fields[j].quoted ? std::string (fields[j].begin, fields[j].end) : std::string (f.begin, f.end);
+                    auto entry = column.lookup.find (text);
+
+                    if (entry == column.lookup.end())
+                    {
+                        entry = column.lookup.emplace (text, std::int32_t (column.dictionary.size())).first;
+                        column.dictionary.push_back (text);
+                    }
+                    column.codes.push_back (entry->second);
+                    break;
+                }
+            }
+        }
+        row += 1;
+        return true;
+    });
+}
+
+unsigned long CsvLoader::getNumColumns() const
+{
+    return columns.size();
+}
+
+unsigned long CsvLoader::getNumRows() const
+{
+    return numRows;
+}
+
+std::string CsvLoader::getColumnName (int index) const
+{
+    return names.at (index);
+}
+
+CsvLoader::ColumnType CsvLoader::getColumnType (int index) const
+{
+    return columns.at (index).type;
+}
+
+std::shared_ptr<UserData> CsvLoader::takeColumnData (int index)
+{
+    auto& column = columns.at (index);
+
+    switch (column.type)
+    {
+        case ColumnType::boolean: return std::make_shared<ArrayBool> (std::move (column.booleans));
+        case ColumnType::int64:   return std::make_shared<ArrayInt64> (std::move (column.integers));
+        case ColumnType::float64: return std::make_shared<ArrayDouble1> (std::move (column.doubles));
+        case ColumnType::string:
+            column.lookup.clear();
+            return std::make_shared<ArrayString> (std::move (column.dictionary), std::move (column.codes));
+    }
+    return nullptr;
+}
+
+std::string CsvLoader::getStatusMessage() const
+{
+    return status;
+}
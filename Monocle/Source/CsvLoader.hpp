@@ -0,0 +1,80 @@
+#pragma once
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "Kernel/UserData.hpp"
+#include "3rdParty/ndarray/ndarray.hpp"
+
+namespace mcl { class CsvLoader; }
+
+
+
+
+// =============================================================================
+/**
+Parser for delimited text (CSV, TSV and the like) with quoted fields. The type
+of each column is inferred from its values: a column is boolean if every value
+is true or false, int64 if every value is an integer, double if every value is
+a number or empty (read as NaN), and otherwise string. String columns are
+dictionary-encoded. The source is read in two passes: the first infers the
+column types and counts the rows, and the second fills columns allocated at
+their final size.
+*/
+class mcl::CsvLoader
+{
+public:
+    enum class ColumnType { boolean, int64, float64, string };
+
+    struct Options
+    {
+        /** The field delimiter, or 0 to choose the most frequent of , \t ; and |
+            on the first line. */
+        char delimiter = 0;
+        char quote = '"';
+
+        /** 1 if the first row names the columns, 0 if it does not, and -1 to
+            treat it as a header if none of its fields are empty, numbers, or
+            booleans. */
+        int header = -1;
+    };
+
+    CsvLoader (const char* begin, const char* end, Options options);
+
+    unsigned long getNumColumns() const;
+    unsigned long getNumRows() const;
+    std::string getColumnName (int index) const;
+    ColumnType getColumnType (int index) const;
+
+    /** Move the data of the given column out of the loader, as an ArrayBool,
+        ArrayInt64, ArrayDouble1 or ArrayString. */
+    std::shared_ptr<UserData> takeColumnData (int index);
+
+    /** Return a description of the first malformed row, or an empty string if
+        the source was parsed without error. */
+    std::string getStatusMessage() const;
+
+private:
+    struct Column
+    {
+        ColumnType type = ColumnType::boolean;
+        std::vector<std::uint8_t> booleans;
+        std::vector<std::int64_t> integers;
+        nd::ndarray<double, 1> doubles;
+        std::vector<std::int32_t> codes;
+        std::vector<std::string> dictionary;
+        std::unordered_map<std::string, std::int32_t> lookup;
+    };
+
+    template<typename Callback>
+    bool forEachRow (const char* begin, const char* end, Callback callback);
+    void inferTypes (const char* begin, const char* end);
+    void fillColumns (const char* begin, const char* end);
+
+    Options options;
+    unsigned long numRows = 0;
+    std::vector<std::string> names;
+    std::vector<Column> columns;
+    std::string status;
+    bool hasHeaderRow = false;
+};
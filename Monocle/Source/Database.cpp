@@ -1,38 +1,437 @@
+#include <cmath>
+#include <cstring>
 #include "Database.hpp"
+#include "NumericData.hpp"
+#include "Kernel/Builtin.hpp"
+using namespace mcl;
 
 
 
 
 // ============================================================================
-Database::Database()
+/*
+ The values of an ArrayDouble1 or ArrayFloat1, seen without regard to its
+ precision. Values are only given for arrays that are not deferred, so that
+ inspecting a column never loads it.
+ */
+struct ColumnValues
 {
+    const double* doubles = nullptr;
+    const float* floats = nullptr;
+    std::size_t size = 0;
+    bool isNumeric = false;
+    bool isDeferred = false;
+    bool isExternal = false;
+
+    std::size_t bytes() const
+    {
+        return size * (floats ? sizeof (float) : sizeof (double));
+    }
+};
+
+static ColumnValues valuesOf (const UserData& column)
+{
+    auto values = ColumnValues();
+
+    if (auto array = dynamic_cast<const ArrayDouble1*> (&column))
+    {
+        values.isNumeric = true;
+        values.isDeferred = array->isDeferred();
+        values.isExternal = array->isExternal();
+        values.size = array->size();
+
+        if (! values.isDeferred)
+            values.doubles = array->data();
+    }
+    else if (auto array = dynamic_cast<const ArrayFloat1*> (&column))
+    {
+        values.isNumeric = true;
+        values.isDeferred = array->isDeferred();
+        values.size = array->size();
+
+        if (! values.isDeferred)
+            values.floats = array->data();
+    }
+    return values;
 }
 
-void Database::addListener (Listener* listener)
+/**
+ Fold the values in [start, end) into the statistics, and if hash is not null,
+ also into an FNV-1a hash of their bit patterns.
+ */
+template<typename T, typename Word>
+static void scanValues (const T* data, std::size_t start, std::size_t end, Database::Statistics& statistics, std::uint64_t* hash)
+{
+    auto min = statistics.min;
+    auto max = statistics.max;
+    auto numValid = statistics.count - statistics.nanCount;
+    auto nanCount = statistics.nanCount;
+
+    for (auto i = start; i < end; ++i)
+    {
+        auto x = double (data[i]);
+
+        if (std::isnan (x))
+        {
+            ++nanCount;
+        }
+        else if (numValid++ == 0)
+        {
+            min = max = x;
+        }
+        else
+        {
+            min = x < min ? x : min;
+            max = x > max ? x : max;
+        }
+    }
+
+    if (hash)
+    {
+        auto h = *hash;
+
+        for (auto i = start; i < end; ++i)
+        {
+            Word word;
+            std::memcpy (&word, data + i, sizeof (Word));
+            h = (h ^ word) * 1099511628211ull;
+        }
+        *hash = h;
+    }
+    statistics.min = min;
+    statistics.max = max;
+    statistics.count = end;
+    statistics.nanCount = nanCount;
+}
+
+static void scanValues (const ColumnValues& values, std::size_t start, Database::Statistics& statistics, std::uint64_t* hash)
+{
+    if (values.doubles)
+        scanValues<double, std::uint64_t> (values.doubles, start, values.size, statistics, hash);
+    else if (values.floats)
+        scanValues<float, std::uint32_t> (values.floats, start, values.size, statistics, hash);
+    else
+        statistics.count = values.size;
+}
+
+static bool haveSameValues (const ColumnValues& a, const ColumnValues& b)
+{
+    if (a.size != b.size || bool (a.doubles) != bool (b.doubles) || bool (a.floats) != bool (b.floats))
+        return false;
+
+    if (a.doubles)
+        return a.doubles == b.doubles || std::memcmp (a.doubles, b.doubles, a.bytes()) == 0;
+
+    if (a.floats)
+        return a.floats == b.floats || std::memcmp (a.floats, b.floats, a.bytes()) == 0;
+
+    return false;
+}
+
+
+
+
+// ============================================================================
+Database& Database::getInstance()
 {
-    listeners.add (listener);
+    static Database database;
+    return database;
 }
 
-void Database::removeListener (Listener* listener)
+Database::Object Database::store (const Object& loaded)
 {
-    listeners.remove (listener);
+    {
+        std::lock_guard<std::mutex> lock (mutex);
+        removeExpiredEntries();
+    }
+
+    switch (loaded.type())
+    {
+        case 'D':
+        {
+            auto result = Object::Dict();
+
+            for (const auto& item : loaded.get<Object::Dict>())
+                result[item.first] = store (item.second);
+
+            return result;
+        }
+        case 'L':
+        {
+            auto result = Object::List();
+
+            for (const auto& item : loaded.get<Object::List>())
+                result.push_back (store (item));
+
+            return result;
+        }
+        case 'U':
+        {
+            const auto& column = loaded.get<Object::Data>().v;
+
+            if (! column)
+                return loaded;
+
+            auto isSoleHolder = column.use_count() == 1;
+            auto stored = storeColumn (column, isSoleHolder);
+            return stored == column ? loaded : Object::data (stored);
+        }
+        default: return loaded;
+    }
 }
 
-void Database::addEntry (const Entry& entry)
+bool Database::getStatistics (const std::shared_ptr<UserData>& column, Statistics& statistics)
 {
-    entries.emplace (entry.symbol, entry);
+    if (! column)
+        return false;
+
+    // Load a deferred column before taking the lock, so that loads on other
+    // threads are not held up while it is parsed.
+    if (auto array = dynamic_cast<const ArrayDouble1*> (column.get()))
+        array->data();
+    else if (auto array = dynamic_cast<const ArrayFloat1*> (column.get()))
+        array->data();
+    else
+        return false;
+
+    auto entry = Entry();
+    {
+        std::lock_guard<std::mutex> lock (mutex);
+        auto stored = entries.find (column.get());
+
+        if (stored != entries.end() && stored->second.column.lock() != column)
+        {
+            removeFromIndex (stored->first, stored->second);
+            entries.erase (stored);
+            stored = entries.end();
+        }
+        if (stored == entries.end())
+        {
+            stored = entries.emplace (column.get(), Entry()).first;
+            stored->second.column = column;
+        }
+        entry = stored->second;
+    }
+
+    auto scan = Scan();
+
+    if (! scanNewValues (*column, entry, scan))
+    {
+        statistics = entry.statistics;
+        return true;
+    }
+
+    std::lock_guard<std::mutex> lock (mutex);
+    auto stored = entries.find (column.get());
+
+    if (stored != entries.end() && stored->second.column.lock() == column)
+        applyScan (stored->first, stored->second, scan);
+
+    statistics = scan.statistics;
+    return true;
 }
 
-void Database::removeEntry (const Identifier& symbol)
+Database::Usage Database::getUsage()
 {
-    entries.erase (symbol);
+    std::lock_guard<std::mutex> lock (mutex);
+    auto usage = Usage();
+
+    for (const auto& entry : entries)
+    {
+        if (auto column = entry.second.column.lock())
+        {
+            auto values = valuesOf (*column);
+            usage.numColumns += 1;
+
+            if (values.isDeferred)
+                continue;
+
+            if (values.isExternal)
+                usage.bytesMapped += values.bytes();
+            else
+                usage.bytes += values.bytes();
+        }
+    }
+    usage.bytesDeduplicated = bytesDeduplicated;
+    return usage;
+}
+
+
+
+
+// ============================================================================
+/**
+ Register a column and return it, or an identical column already in the store
+ if the caller allows it to be replaced. Only such columns are added to the
+ content index: a column that someone else also holds may be extended in place,
+ and must not be handed out in place of another. A column that is already
+ registered is left as it is, and its statistics are brought up to date when
+ they are next asked for. The values are scanned and hashed before the lock is
+ taken, so that storing a large column does not hold up other threads. Columns
+ referencing a memory-mapped file are not scanned here, since that would read
+ the whole file; they share the page cache with any identical mapping anyway.
+ */
+std::shared_ptr<UserData> Database::storeColumn (std::shared_ptr<UserData> column, bool mayBeReplaced)
+{
+    auto values = valuesOf (*column);
+
+    if (! values.isNumeric)
+        return column;
+
+    auto entry = Entry();
+    auto scan = Scan();
+    entry.column = column;
+    entry.mayBeIndexed = mayBeReplaced;
+
+    auto isScanned = ! values.isDeferred && ! values.isExternal && scanNewValues (*column, entry, scan);
+
+    std::lock_guard<std::mutex> lock (mutex);
+    auto existing = entries.find (column.get());
+
+    if (existing != entries.end() && existing->second.column.lock() == column)
+    {
+        return column;
+    }
+
+    if (isScanned && scan.isHashed)
+    {
+        auto candidates = contentIndex.equal_range (scan.hash);
+
+        for (auto candidate = candidates.first; candidate != candidates.second; ++candidate)
+        {
+            auto other = entries.at (candidate->second).column.lock();
+
+            if (other && haveSameValues (valuesOf (*other), values))
+            {
+                bytesDeduplicated += values.bytes();
+                return other;
+            }
+        }
+    }
+
+    if (existing != entries.end())
+    {
+        removeFromIndex (existing->first, existing->second);
+        entries.erase (existing);
+    }
+    auto& stored = entries.emplace (column.get(), entry).first->second;
+
+    if (isScanned)
+        applyScan (column.get(), stored, scan);
+
+    return column;
+}
+
+/**
+ Scan the values of a column that its entry does not yet describe: those
+ past its count, or all of them if the column has shrunk. A column that may
+ be indexed is hashed as well when it is scanned from the start. Return false
+ if the column is deferred, or the entry is up to date.
+ */
+bool Database::scanNewValues (const UserData& column, const Entry& entry, Scan& scan)
+{
+    auto values = valuesOf (column);
+
+    if (values.isDeferred || (values.size == entry.statistics.count && entry.statistics.count > 0))
+        return false;
+
+    scan.startCount = entry.statistics.count;
+    scan.statistics = values.size < entry.statistics.count ? Statistics() : entry.statistics;
+    scan.isHashed = entry.mayBeIndexed && scan.statistics.count == 0;
+    scan.hash = 14695981039346656037ull ^ values.size;
+    scanValues (values, scan.statistics.count, scan.statistics, scan.isHashed ? &scan.hash : nullptr);
+    return true;
+}
+
+/**
+ Bring an entry up to date with a scan of its column, unless another scan has
+ updated it since this one started. An array that has grown is removed from
+ the content index, because its hash no longer describes it, and one that
+ was hashed from the start is added to it.
+ */
+void Database::applyScan (const UserData* address, Entry& entry, const Scan& scan)
+{
+    if (entry.statistics.count != scan.startCount)
+        return;
+
+    removeFromIndex (address, entry);
+    entry.statistics = scan.statistics;
+
+    if (scan.isHashed)
+    {
+        entry.hash = scan.hash;
+        contentIndex.emplace (scan.hash, address);
+        entry.isIndexed = true;
+    }
+}
+
+void Database::removeFromIndex (const UserData* address, Entry& entry)
+{
+    if (! entry.isIndexed)
+        return;
+
+    auto candidates = contentIndex.equal_range (entry.hash);
+
+    for (auto candidate = candidates.first; candidate != candidates.second; ++candidate)
+    {
+        if (candidate->second == address)
+        {
+            contentIndex.erase (candidate);
+            break;
+        }
+    }
+    entry.isIndexed = false;
+}
+
+void Database::removeExpiredEntries()
+{
+    for (auto entry = entries.begin(); entry != entries.end(); )
+    {
+        if (entry->second.column.expired())
+        {
+            removeFromIndex (entry->first, entry->second);
+            entry = entries.erase (entry);
+        }
+        else ++entry;
+    }
+}
+
+
+
+
+// ============================================================================
+Database::Object::Dict Database::database()
+{
+    auto m = Object::Dict();
+    m["column-stats"] = Object::Func (column_stats, "(column-stats array:{ArrayDouble1|ArrayFloat1}) -> {dict}");
+    m["memory-usage"] = Object::Func (memory_usage, "(memory-usage) -> {dict}");
+    return m;
+}
+
+Database::Object Database::column_stats (const Object::List& args, const Object::Dict&)
+{
+    auto statistics = Statistics();
+
+    if (! getInstance().getStatistics (Builtin::check<Object::Data> (args, 0).v, statistics))
+    {
+        throw std::runtime_error ("column-stats requires an ArrayDouble1 or ArrayFloat1");
+    }
+    auto result = Object::Dict();
+    auto hasValues = statistics.count > statistics.nanCount;
+    result["count"] = double (statistics.count);
+    result["nans"] = double (statistics.nanCount);
+    result["min"] = hasValues ? statistics.min : std::nan ("");
+    result["max"] = hasValues ? statistics.max : std::nan ("");
+    return result;
 }
 
-Array<Database::Entry> Database::getEntries() const
+Database::Object Database::memory_usage (const Object::List&, const Object::Dict&)
 {
-    Array<Entry> e;
-    
-    for (const auto& pair : entries)
-        e.add (pair.second);
-    return e;
+    auto usage = getInstance().getUsage();
+    auto result = Object::Dict();
+    result["columns"] = double (usage.numColumns);
+    result["bytes"] = double (usage.bytes);
+    result["mapped"] = double (usage.bytesMapped);
+    result["deduplicated"] = double (usage.bytesDeduplicated);
+    return result;
 }
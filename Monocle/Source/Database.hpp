@@ -1,38 +1,117 @@
 #pragma once
-#include <map>
-#include "JuceHeader.h"
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include "Kernel/Object.hpp"
 
 
 
 
 // ============================================================================
+/**
+The store of numeric columns produced by the loaders. Columns are held by the
+symbols and plots that use them, as shared UserData; the database keeps weak
+references to them, so a column is released as soon as nothing refers to it.
+For each column it records statistics (the count, the number of NaN values,
+and the minimum and maximum of the others), and an index of column contents
+that allows a newly loaded column to be replaced by an identical one that is
+already in memory.
+
+The database is shared by all the loaders, and may be written to from the
+background threads that load files.
+*/
 class Database
 {
 public:
+    using Object = mcl::Object;
+
     // ========================================================================
-    struct Entry
+    struct Statistics
     {
-        Identifier symbol;
-        std::shared_ptr<std::vector<double>> data;
-        std::vector<size_t> shape;
+        std::size_t count = 0;
+        std::size_t nanCount = 0;
+        double min = 0.0;
+        double max = 0.0;
     };
 
-    // ========================================================================
-    class Listener
+    struct Usage
     {
-    public:
-        virtual ~Listener() {}
+        /** The number of columns that are alive. */
+        std::size_t numColumns = 0;
+
+        /** The bytes held by columns in memory they own. */
+        std::size_t bytes = 0;
+
+        /** The bytes referenced by columns from memory-mapped files. */
+        std::size_t bytesMapped = 0;
+
+        /** The bytes that loads did not keep because an identical column was
+            already in memory. */
+        std::size_t bytesDeduplicated = 0;
     };
 
     // ========================================================================
-    Database();
-    void addListener (Listener* listener);
-    void removeListener (Listener* listener);
-    void addEntry (const Entry& entry);
-    void removeEntry (const Identifier& symbol);
-    Array<Entry> getEntries() const;
+    static Database& getInstance();
+
+    /** Register the ArrayDouble1 and ArrayFloat1 columns in a loaded object,
+        which may be an array or a dict or list of them, and return the object
+        with each column replaced by an identical one already in the store, if
+        there is one. A column is only replaced if the loaded object is its
+        sole holder, so that a loader that extends its columns in place (such
+        as load-txt with follow=1) keeps them. Statistics are computed for
+        columns whose values are in memory; those of deferred and
+        memory-mapped columns are computed when they are first asked for.
+        Only columns whose values are in memory can be replaced, since
+        comparing the others would read them; a deferred or memory-mapped
+        column is added to the content index once its statistics have been
+        computed, so that later loads may be replaced by it.
+     */
+    Object store (const Object& loaded);
+
+    /** Return the statistics of a column, computing them if they are not yet
+        known or the column has grown. Returns false if the data is not an
+        ArrayDouble1 or ArrayFloat1.
+     */
+    bool getStatistics (const std::shared_ptr<mcl::UserData>& column, Statistics& statistics);
+    Usage getUsage();
+
+    static Object::Dict database();
+    static Object column_stats (const Object::List&, const Object::Dict&);
+    static Object memory_usage (const Object::List&, const Object::Dict&);
 
 private:
-    std::map<Identifier, Entry> entries;
-    ListenerList<Listener> listeners;
+    // ========================================================================
+    struct Entry
+    {
+        std::weak_ptr<mcl::UserData> column;
+        Statistics statistics;
+        std::uint64_t hash = 0;
+        bool isIndexed = false;
+        bool mayBeIndexed = false;
+    };
+
+    /** The values of a column scanned since its entry was last updated. The
+        scan is made without holding the lock, and applied to the entry under
+        it, unless the entry was updated by another scan in the meantime.
+     */
+    struct Scan
+    {
+        std::size_t startCount = 0;
+        Statistics statistics;
+        std::uint64_t hash = 0;
+        bool isHashed = false;
+    };
+
+    Database() {}
+    std::shared_ptr<mcl::UserData> storeColumn (std::shared_ptr<mcl::UserData> column, bool mayBeReplaced);
+    static bool scanNewValues (const mcl::UserData& column, const Entry& entry, Scan& scan);
+    void applyScan (const mcl::UserData* address, Entry& entry, const Scan& scan);
+    void removeFromIndex (const mcl::UserData* address, Entry& entry);
+    void removeExpiredEntries();
+
+    std::unordered_map<const mcl::UserData*, Entry> entries;
+    std::unordered_multimap<std::uint64_t, const mcl::UserData*> contentIndex;
+    std::size_t bytesDeduplicated = 0;
+    std::mutex mutex;
 };
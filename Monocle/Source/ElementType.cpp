@@ -0,0 +1,137 @@
+#include "ElementType.hpp"
+
+
+
+
+// ============================================================================
+template<typename Bits>
+static Bits swapBytes (Bits bits)          { return ByteOrder::swap (bits); }
+template<>
+uint8 swapBytes<uint8> (uint8 bits)         { return bits; }
+
+/**
+ The loops are kept free of branches and calls, with the byte order decided
+ outside of them, so that the compiler can vectorize them: the byte swaps
+ compile to shuffles and the conversions to packed converts.
+ */
+template<typename T, typename Bits>
+static void convertElements (const char* source, std::size_t stride, double* target, std::size_t count, bool swap)
+{
+    static_assert (sizeof (T) == sizeof (Bits), "element and bit types must have the same size");
+
+    if (swap)
+    {
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            Bits bits;
+            T value;
+            std::memcpy (&bits, source + i * stride, sizeof (Bits));
+            bits = swapBytes (bits);
+            std::memcpy (&value, &bits, sizeof (T));
+            target[i] = double (value);
+        }
+    }
+    else
+    {
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            T value;
+            std::memcpy (&value, source + i * stride, sizeof (T));
+            target[i] = double (value);
+        }
+    }
+}
+
+static bool isSupported (char kind, int size)
+{
+    switch (kind)
+    {
+        case 'f': return size == 4 || size == 8;
+        case 'i':
+        case 'u': return size == 1 || size == 2 || size == 4 || size == 8;
+        default: return false;
+    }
+}
+
+static bool isForeignByteOrder (bool isLittleEndian)
+{
+   #if JUCE_LITTLE_ENDIAN
+    return ! isLittleEndian;
+   #else
+    return isLittleEndian;
+   #endif
+}
+
+
+
+
+// ============================================================================
+ElementType ElementType::fromNumpyDescr (const std::string& descr)
+{
+    auto type = ElementType();
+    auto order = descr.empty() ? ' ' : descr[0];
+
+    if (descr.size() < 3 || (order != '<' && order != '>' && order != '|' && order != '='))
+        throw std::runtime_error ("unsupported dtype " + descr);
+
+    type.kind = descr[1];
+    type.size = std::atoi (descr.c_str() + 2);
+    type.swap = (order == '<' || order == '>') && isForeignByteOrder (order == '<');
+
+    if (! isSupported (type.kind, type.size))
+        throw std::runtime_error ("unsupported dtype " + descr);
+
+    return type;
+}
+
+ElementType ElementType::fromName (const std::string& name, const std::string& byteOrder)
+{
+    auto type = ElementType();
+
+    if (name.size() < 2)
+        throw std::runtime_error ("unsupported dtype " + name);
+
+    type.kind = name[0];
+    type.size = std::atoi (name.c_str() + 1) / 8;
+
+    if (! isSupported (type.kind, type.size) || name != type.kind + std::to_string (type.size * 8))
+        throw std::runtime_error ("unsupported dtype " + name);
+
+    if (byteOrder == "little" || byteOrder == "big")
+        type.swap = type.size > 1 && isForeignByteOrder (byteOrder == "little");
+    else if (byteOrder != "native")
+        throw std::runtime_error ("byte order must be little, big, or native");
+
+    return type;
+}
+
+bool ElementType::isNativeDouble() const
+{
+    return kind == 'f' && size == 8 && ! swap;
+}
+
+void ElementType::convert (const char* source, std::size_t stride, double* target, std::size_t count) const
+{
+    switch (kind)
+    {
+        case 'f':
+            if (size == 4) return convertElements<float, uint32> (source, stride, target, count, swap);
+            else           return convertElements<double, uint64> (source, stride, target, count, swap);
+        case 'i':
+            switch (size)
+            {
+                case 1:  return convertElements<int8,  uint8>  (source, stride, target, count, swap);
+                case 2:  return convertElements<int16, uint16> (source, stride, target, count, swap);
+                case 4:  return convertElements<int32, uint32> (source, stride, target, count, swap);
+                default: return convertElements<int64, uint64> (source, stride, target, count, swap);
+            }
+        default:
+            switch (size)
+            {
+                case 1:  return convertElements<uint8,  uint8>  (source, stride, target, count, swap);
+                case 2:  return convertElements<uint16, uint16> (source, stride, target, count, swap);
+                case 4:  return convertElements<uint32, uint32> (source, stride, target, count, swap);
+                default: return convertElements<uint64, uint64> (source, stride, target, count, swap);
+            }
+    }
+}
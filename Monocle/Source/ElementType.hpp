@@ -0,0 +1,38 @@
+#pragma once
+#include "JuceHeader.h"
+
+
+
+
+// ============================================================================
+/**
+The type and byte order of the elements of a binary array, as stored in a file.
+Elements of any supported type are converted to double by convert.
+*/
+struct ElementType
+{
+    /** Return the type named by a NumPy descr string, such as '<f8' or '>i4'.
+        Throws std::runtime_error if the type is not supported.
+     */
+    static ElementType fromNumpyDescr (const std::string& descr);
+
+    /** Return the type with the given name (f32, f64, i8, i16, i32, i64, u8,
+        u16, u32 or u64) and byte order (little, big or native). Throws
+        std::runtime_error if either is not recognized.
+     */
+    static ElementType fromName (const std::string& name, const std::string& byteOrder);
+
+    /** Return true if the elements are doubles in the byte order of this
+        machine, so that they can be used without conversion.
+     */
+    bool isNativeDouble() const;
+
+    /** Convert count elements, spaced stride bytes apart at source, to double.
+        The source need not be aligned.
+     */
+    void convert (const char* source, std::size_t stride, double* target, std::size_t count) const;
+
+    char kind = 'f';
+    int size = 8;
+    bool swap = false;
+};
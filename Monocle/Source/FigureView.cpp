@@ -138,11 +138,11 @@ void FigureView::PlotArea::paint (Graphics& g)
     for (const auto& tick : xticks) g.drawVerticalLine (tick.pixel, 0, getHeight());
     for (const auto& tick : yticks) g.drawHorizontalLine (tick.pixel, 0, getWidth());
 
+    for (const auto& p : figure.model.imagePlots) paintImagePlot (g, p);
     for (const auto& p : figure.model.linePlots) paintLinePlot (g, p);
     for (const auto& p : figure.model.fillBetweens) paintFillBetween (g, p);
     for (const auto& p : figure.model.scatterPlots) paintScatterPlot (g, p);
     for (const auto& p : figure.model.histograms) paintHistogram (g, p);
-    for (const auto& p : figure.model.imagePlots) paintImagePlot (g, p);
 }
 
 void FigureView::PlotArea::resized()
@@ -211,7 +211,19 @@ void FigureView::PlotArea::paintLinePlot (Graphics& g, const LinePlotModel& line
 void FigureView::PlotArea::paintFillBetween (Graphics& g, const FillBetweenModel& fillBetween) {}
 void FigureView::PlotArea::paintScatterPlot (Graphics& g, const ScatterPlotModel& scatterPlot) {}
 void FigureView::PlotArea::paintHistogram (Graphics& g, const HistogramModel& histogram) {}
-void FigureView::PlotArea::paintImagePlot (Graphics& g, const ImagePlotModel& imagePlot) {}
+
+void FigureView::PlotArea::paintImagePlot (Graphics& g, const ImagePlotModel& imagePlot)
+{
+    if (! imagePlot.image.isValid())
+        return;
+
+    auto area = Rectangle<double>::leftTopRightBottom (fromDomainX (imagePlot.extent.getX()),
+                                                      fromDomainY (imagePlot.extent.getBottom()),
+                                                      fromDomainX (imagePlot.extent.getRight()),
+                                                      fromDomainY (imagePlot.extent.getY()));
+    g.setImageResamplingQuality (Graphics::lowResamplingQuality);
+    g.drawImage (imagePlot.image, area.toFloat(), RectanglePlacement::stretchToFit);
+}
 
 
 
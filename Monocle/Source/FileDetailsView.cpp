@@ -30,6 +30,27 @@ void FileDetailsView::updateFileDetailsIfShowing (File file)
         repaint();
 }
 
+void FileDetailsView::setFileLoadProgress (File file, double fraction, double secondsRemaining)
+{
+    if (fraction < 0.0)
+        loadProgress.erase (file.getFullPathName());
+    else
+        loadProgress[file.getFullPathName()] = String (int (fraction * 100)) + "%"
+        + (secondsRemaining >= 0.0 ? ", " + String (int (secondsRemaining + 0.5)) + "s remaining" : String());
+
+    updateFileDetailsIfShowing (file);
+}
+
+void FileDetailsView::setFileLoadError (File file, const String& error)
+{
+    if (error.isEmpty())
+        loadErrors.erase (file.getFullPathName());
+    else
+        loadErrors[file.getFullPathName()] = error;
+
+    updateFileDetailsIfShowing (file);
+}
+
 void FileDetailsView::paint (Graphics& g)
 {
     if (currentFilenames.isEmpty())
@@ -51,6 +72,20 @@ void FileDetailsView::paint (Graphics& g)
         g.drawText ("size: " + sizeString, geom.fileSize, Justification::bottomLeft);
     if (currentFilenames.size() == 1)
         g.drawText ("modified: " + modifiedString, geom.modified, Justification::bottomLeft);
+
+    auto progress = loadProgress.find (currentFilenames[0]);
+
+    auto error = loadErrors.find (currentFilenames[0]);
+
+    if (currentFilenames.size() == 1 && progress != loadProgress.end())
+    {
+        g.drawText ("loading: " + progress->second, geom.loading, Justification::bottomLeft);
+    }
+    else if (currentFilenames.size() == 1 && error != loadErrors.end())
+    {
+        g.setColour (Colours::red);
+        g.drawText ("load failed: " + error->second, geom.loading, Justification::bottomLeft);
+    }
 }
 
 void FileDetailsView::resized()
@@ -68,5 +103,6 @@ FileDetailsView::Geometry FileDetailsView::computeGeometry() const
     g.icon     = col1.removeFromTop (rowHeight).reduced(6);
     g.fileSize = col2.removeFromTop (rowHeight);
     g.modified = col2.removeFromTop (rowHeight);
+    g.loading  = col2.removeFromTop (rowHeight);
     return g;
 }
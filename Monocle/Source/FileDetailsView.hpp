@@ -19,6 +19,7 @@ public:
         Rectangle<int> icon;
         Rectangle<int> fileSize;
         Rectangle<int> modified;
+        Rectangle<int> loading;
     };
 
     FileDetailsView();
@@ -27,6 +28,17 @@ public:
     void setCurrentlyActiveFiles (const StringArray& names);
     void updateFileDetailsIfShowing (File file);
 
+    /** Show the progress of a background load of a file, or hide it if the
+        fraction is negative. The time remaining is not shown if it is
+        negative.
+     */
+    void setFileLoadProgress (File file, double fraction, double secondsRemaining);
+
+    /** Show the error with which a background load of a file failed, or hide
+        it if the error is empty.
+     */
+    void setFileLoadError (File file, const String& error);
+
     //==============================================================================
     void paint (Graphics& g) override;
     void resized() override;
@@ -36,5 +48,7 @@ private:
 
     ListenerList<Listener> listeners;
     StringArray currentFilenames;
+    std::map<String, String> loadProgress;
+    std::map<String, String> loadErrors;
     bool filterIsCurrentlyValid = false;
 };
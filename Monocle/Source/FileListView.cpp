@@ -53,6 +53,26 @@ void FileListView::updateFileDisplayStatus (File file)
     repaintRow (files.indexOf (file));
 }
 
+void FileListView::setFileLoadProgress (File file, double fraction)
+{
+    if (fraction < 0.0)
+        loadProgress.erase (file.getFullPathName());
+    else
+        loadProgress[file.getFullPathName()] = fraction;
+
+    updateFileDisplayStatus (file);
+}
+
+void FileListView::setFileLoadError (File file, const String& error)
+{
+    if (error.isEmpty())
+        loadErrors.erase (file.getFullPathName());
+    else
+        loadErrors[file.getFullPathName()] = error;
+
+    updateFileDisplayStatus (file);
+}
+
 Array<File> FileListView::getSelectedFiles() const
 {
     Array<File> selectedFiles;
@@ -116,6 +136,19 @@ void FileListView::paintListBoxItem (int row, Graphics& g, int w, int h, bool se
 
     g.setColour (files[row].exists() ? Colours::black : Colours::red);
     g.drawText (files[row].getFileName(), h, 0, w, h, Justification::centredLeft);
+
+    auto progress = loadProgress.find (files[row].getFullPathName());
+
+    if (progress != loadProgress.end())
+    {
+        g.setColour (Colours::seagreen);
+        g.fillRect (float (h), float (h - 3), float (w - h) * float (progress->second), 2.f);
+    }
+    else if (loadErrors.count (files[row].getFullPathName()))
+    {
+        g.setColour (Colours::red);
+        g.fillRect (float (h), float (h - 3), float (w - h), 2.f);
+    }
 }
 
 void FileListView::listBoxItemClicked (int row, const MouseEvent& e)
@@ -168,6 +201,11 @@ void FileListView::listWasScrolled()
 
 String FileListView::getTooltipForRow (int row)
 {
+    auto error = loadErrors.find (files[row].getFullPathName());
+
+    if (error != loadErrors.end())
+        return files[row].getFullPathName() + "\n" + error->second;
+
     return files[row].getFullPathName();
 }
 
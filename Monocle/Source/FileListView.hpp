@@ -29,6 +29,16 @@ public:
     void removeListener (Listener* listener);
     void setFileList (const Array<File>& filesToDisplay);
     void updateFileDisplayStatus (File file);
+
+    /** Show the fraction of a file that has been loaded in the background, or
+        hide it if the fraction is negative.
+     */
+    void setFileLoadProgress (File file, double fraction);
+
+    /** Mark a file whose background load failed, showing the error in its
+        tooltip, or clear the mark if the error is empty.
+     */
+    void setFileLoadError (File file, const String& error);
     Array<File> getSelectedFiles() const;
     StringArray getSelectedFullPathNames() const;
 
@@ -67,6 +77,8 @@ private:
     };
 
     Array<File> files;
+    std::map<String, double> loadProgress;
+    std::map<String, String> loadErrors;
     ListenerList<Listener> listeners;
     std::unique_ptr<Drawable> fileIcon;
     std::unique_ptr<Drawable> directoryIcon;
@@ -1,12 +1,369 @@
+#include <deque>
 #include "FileManager.hpp"
+#if JUCE_LINUX
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+
+
+
+// ============================================================================
+static const int64 hashBlockSize = 65536;
+static const uint64 fnvOffsetBasis = 14695981039346656037ull;
+
+/**
+ Return the FNV-1a hash of the bytes [start, end) of a file, continuing from
+ the given hash, and set numHashed to the number of bytes that could be read.
+ Reading stops early if the calling thread is asked to exit.
+ */
+static uint64 hashFileBytes (FileInputStream& stream, int64 start, int64 end, uint64 hash, int64& numHashed)
+{
+    HeapBlock<uint8> buffer (hashBlockSize);
+    numHashed = 0;
+
+    if (! stream.setPosition (start))
+        return hash;
+
+    while (start + numHashed < end && ! Thread::currentThreadShouldExit())
+    {
+        auto numRead = stream.read (buffer.getData(), int (jmin (hashBlockSize, end - start - numHashed)));
+
+        if (numRead <= 0)
+            break;
+
+        for (int n = 0; n < numRead; ++n)
+            hash = (hash ^ buffer[n]) * 1099511628211ull;
+
+        numHashed += numRead;
+    }
+    return hash;
+}
+
+
+
+
+// ============================================================================
+/**
+ Hashes the content of files on a background thread, so that reading a large
+ file never stalls the message thread. Each result is handed back with the
+ request it answers, which records the size and modification time the file had
+ when it was requested, and the owner is sent an async update.
+ */
+class FileManager::ContentHasher : public Thread
+{
+public:
+    struct Request
+    {
+        File file;
+        int64 size = 0;
+        Time modified;
+        ContentHash previous;
+    };
+
+    struct Result
+    {
+        Request request;
+        ContentHash content;
+    };
+
+    ContentHasher (AsyncUpdater& owner) : Thread ("FileManager hasher"), owner (owner)
+    {
+        startThread();
+    }
+
+    ~ContentHasher()
+    {
+        signalThreadShouldExit();
+        notify();
+        stopThread (-1);
+    }
+
+    void request (const Request& request)
+    {
+        {
+            const ScopedLock lock (mutex);
+            requests.push_back (request);
+        }
+        notify();
+    }
+
+    std::vector<Result> takeResults()
+    {
+        const ScopedLock lock (mutex);
+        auto taken = std::vector<Result>();
+        taken.swap (results);
+        return taken;
+    }
+
+    void run() override
+    {
+        while (! threadShouldExit())
+        {
+            auto next = Request();
+            auto hasRequest = false;
+            {
+                const ScopedLock lock (mutex);
+
+                if (! requests.empty())
+                {
+                    next = requests.front();
+                    requests.pop_front();
+                    hasRequest = true;
+                }
+            }
+            if (! hasRequest)
+            {
+                wait (-1);
+                continue;
+            }
+            auto content = hashFileContent (next.file, next.size, next.previous);
+
+            if (threadShouldExit())
+                break;
+            {
+                const ScopedLock lock (mutex);
+                results.push_back ({ next, content });
+            }
+            owner.triggerAsyncUpdate();
+        }
+    }
+
+private:
+    /**
+     Hash the first size bytes of a file. If it is larger than when it was
+     previously hashed, and the 64 KB before its previous size are unchanged,
+     it is taken to have been appended to, and only the new bytes are read. A
+     rewrite that grows the file and leaves those bytes in place is therefore
+     mistaken for an append, as it is when following a file.
+     */
+    static ContentHash hashFileContent (const File& file, int64 size, const ContentHash& previous)
+    {
+        FileInputStream stream (file);
+        auto content = ContentHash();
+        auto start = int64 (0);
+        auto numHashed = int64 (0);
+        content.hash = fnvOffsetBasis;
+
+        if (stream.failedToOpen())
+            return content;
+
+        if (previous.size > 0 && size > previous.size)
+        {
+            auto tailStart = jmax (int64 (0), previous.size - hashBlockSize);
+            auto tailHash = hashFileBytes (stream, tailStart, previous.size, fnvOffsetBasis, numHashed);
+
+            if (numHashed == previous.size - tailStart && tailHash == previous.tailHash)
+            {
+                start = previous.size;
+                content.hash = previous.hash;
+            }
+        }
+        content.hash = hashFileBytes (stream, start, size, content.hash, numHashed);
+        content.size = start + numHashed;
+
+        auto tailStart = jmax (int64 (0), content.size - hashBlockSize);
+        content.tailHash = hashFileBytes (stream, tailStart, content.size, fnvOffsetBasis, numHashed);
+        return content;
+    }
+
+    AsyncUpdater& owner;
+    CriticalSection mutex;
+    std::deque<Request> requests;
+    std::vector<Result> results;
+};
+
+
+
+
+// ============================================================================
+#if JUCE_LINUX
+/**
+ Watches a set of directories with inotify. The thread sleeps in poll() until
+ the kernel reports an event, records the path of the file the event names,
+ and triggers an async update of the FileManager, which then refreshes only
+ the files that were named. A pipe is used to wake the thread when it is to
+ exit.
+ */
+class FileManager::DirectoryWatcher : public Thread
+{
+public:
+    static std::unique_ptr<DirectoryWatcher> create (AsyncUpdater& owner)
+    {
+        int inotifyFd = inotify_init1 (IN_NONBLOCK | IN_CLOEXEC);
+        int wakeFds[2];
+
+        if (inotifyFd == -1)
+            return nullptr;
+
+        if (pipe2 (wakeFds, O_NONBLOCK | O_CLOEXEC) == -1)
+        {
+            close (inotifyFd);
+            return nullptr;
+        }
+        auto watcher = std::unique_ptr<DirectoryWatcher> (new DirectoryWatcher (owner, inotifyFd, wakeFds));
+        watcher->startThread();
+        return watcher;
+    }
+
+    ~DirectoryWatcher()
+    {
+        signalThreadShouldExit();
+        char byte = 0;
+        ignoreUnused (write (wakeFds[1], &byte, 1));
+        stopThread (-1);
+        close (inotifyFd);
+        close (wakeFds[0]);
+        close (wakeFds[1]);
+    }
+
+    /** Watch exactly the given directories, and return false if any of them
+        could not be watched.
+     */
+    bool setDirectories (const Array<File>& newDirectories)
+    {
+        const ScopedLock lock (mutex);
+        auto watchedAll = true;
+
+        for (auto it = directories.begin(); it != directories.end(); )
+        {
+            if (! newDirectories.contains (it->second))
+            {
+                inotify_rm_watch (inotifyFd, it->first);
+                it = directories.erase (it);
+            }
+            else ++it;
+        }
+
+        for (const auto& directory : newDirectories)
+        {
+            auto wd = inotify_add_watch (inotifyFd, directory.getFullPathName().toRawUTF8(), eventMask);
+
+            if (wd == -1)
+                watchedAll = false;
+            else
+                directories[wd] = directory;
+        }
+        return watchedAll;
+    }
+
+    /** Return the paths of the files that changed since the last call. If
+        the kernel dropped events, overflowed is set, and any file may have
+        changed. If a watched directory was deleted, moved or unmounted, so
+        that it is no longer watched, lostDirectory is set.
+     */
+    StringArray takeChangedFiles (bool& overflowed, bool& lostDirectory)
+    {
+        const ScopedLock lock (mutex);
+        auto files = StringArray();
+        files.swapWith (changedFiles);
+        overflowed = queueOverflowed;
+        lostDirectory = directoryLost;
+        queueOverflowed = false;
+        directoryLost = false;
+        return files;
+    }
+
+    void run() override
+    {
+        alignas (inotify_event) char buffer[4096];
+        pollfd fds[2] = { { inotifyFd, POLLIN, 0 }, { wakeFds[0], POLLIN, 0 } };
+
+        while (! threadShouldExit())
+        {
+            if (poll (fds, 2, -1) <= 0 || fds[1].revents != 0)
+                continue;
+
+            auto length = read (inotifyFd, buffer, sizeof (buffer));
+
+            if (length <= 0)
+                continue;
+
+            const ScopedLock lock (mutex);
+
+            for (auto p = buffer; p < buffer + length; )
+            {
+                auto event = reinterpret_cast<const inotify_event*> (p);
+                auto directory = directories.find (event->wd);
+
+                if (event->mask & IN_Q_OVERFLOW)
+                {
+                    queueOverflowed = true;
+                }
+                else if (event->mask & (IN_IGNORED | IN_MOVE_SELF))
+                {
+                    // A moved directory is still watched, but under its old
+                    // path, so its watch is dropped as for a deleted one. The
+                    // IN_IGNORED that follows, or that follows one removed by
+                    // setDirectories, names a watch that is already gone.
+                    if (directory != directories.end())
+                    {
+                        if (event->mask & IN_MOVE_SELF)
+                            inotify_rm_watch (inotifyFd, event->wd);
+
+                        directories.erase (directory);
+                        directoryLost = true;
+                    }
+                }
+                else if (event->len > 0 && directory != directories.end())
+                {
+                    changedFiles.addIfNotAlreadyThere (directory->second.getChildFile (event->name).getFullPathName());
+                }
+
+                p += sizeof (inotify_event) + event->len;
+            }
+            owner.triggerAsyncUpdate();
+        }
+    }
+
+private:
+    DirectoryWatcher (AsyncUpdater& owner, int inotifyFd, int fds[2])
+    : Thread ("FileManager")
+    , owner (owner)
+    , inotifyFd (inotifyFd)
+    {
+        wakeFds[0] = fds[0];
+        wakeFds[1] = fds[1];
+    }
+
+    static const uint32 eventMask = IN_MODIFY | IN_CLOSE_WRITE | IN_ATTRIB | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_MOVE_SELF;
+    AsyncUpdater& owner;
+    int inotifyFd;
+    int wakeFds[2];
+    CriticalSection mutex;
+    std::map<int, File> directories;
+    StringArray changedFiles;
+    bool queueOverflowed = false;
+    bool directoryLost = false;
+};
+#else
+class FileManager::DirectoryWatcher
+{
+public:
+    static std::unique_ptr<DirectoryWatcher> create (AsyncUpdater&) { return nullptr; }
+    bool setDirectories (const Array<File>&) { return false; }
+    StringArray takeChangedFiles (bool& overflowed, bool& lostDirectory) { overflowed = lostDirectory = false; return {}; }
+};
+#endif
 
 
 
 
 // ============================================================================
 FileManager::FileManager()
+: watcher (DirectoryWatcher::create (*this))
+, hasher (new ContentHasher (*this))
+{
+    updateWatchedDirectories();
+}
+
+FileManager::~FileManager()
 {
-    startTimer (1000);
+    watcher.reset();
+    hasher.reset();
+    cancelPendingUpdate();
 }
 
 void FileManager::addListener (Listener* listener)
@@ -21,7 +378,25 @@ void FileManager::removeListener (Listener* listener)
 
 void FileManager::setPollingInterval (int millisecondsBetweenPolling)
 {
-    startTimer (millisecondsBetweenPolling);
+    pollingInterval = millisecondsBetweenPolling;
+    updateWatchedDirectories();
+}
+
+void FileManager::setSettleTime (int milliseconds)
+{
+    settleTime = milliseconds;
+    updateTimer();
+}
+
+void FileManager::setContentVerification (bool shouldVerify)
+{
+    shouldVerifyContent = shouldVerify;
+
+    if (shouldVerifyContent)
+    {
+        for (auto& status : statuses)
+            requestContentHash (status);
+    }
 }
 
 void FileManager::setUniqueKey (const String &filename, const std::string &key)
@@ -32,25 +407,43 @@ void FileManager::setUniqueKey (const String &filename, const std::string &key)
 
 void FileManager::addFile (File file)
 {
-    statuses.addIfNotAlreadyThere (file);
+    if (statuses.addIfNotAlreadyThere (file) && shouldVerifyContent)
+    {
+        requestContentHash (statuses.getReference (statuses.size() - 1));
+    }
+
+    updateWatchedDirectories();
 }
 
 void FileManager::removeFile (File file)
 {
     statuses.removeFirstMatchingValue (file);
+    updateWatchedDirectories();
 }
 
 void FileManager::insertFiles (const StringArray& filenames, int index)
 {
     for (const auto& filename : filenames)
+    {
         if (! statuses.contains (File (filename)))
-            statuses.insert (index, File (filename));
+        {
+            auto status = FileStatus (File (filename));
+
+            if (shouldVerifyContent)
+                requestContentHash (status);
+
+            statuses.insert (index, status);
+        }
+    }
+    updateWatchedDirectories();
 }
 
 void FileManager::removeFiles (const StringArray& filenames)
 {
     for (const auto& filename : filenames)
         statuses.removeFirstMatchingValue (File (filename));
+
+    updateWatchedDirectories();
 }
 
 Array<File> FileManager::getFiles() const
@@ -68,6 +461,11 @@ std::string FileManager::getUniqueKey (const String& filename) const
     return statuses.getReference(n).uniqueKey;
 }
 
+bool FileManager::wasAppendedTo (File file) const
+{
+    return getStatusForFile (file).grew;
+}
+
 
 
 
@@ -79,6 +477,9 @@ FileManager::FileStatus::FileStatus()
 FileManager::FileStatus::FileStatus (File file) : file (file)
 {
     refreshFromDisk();
+    pending = false;
+    reportedSize = size;
+    reportedExisted = existed;
 }
 
 bool FileManager::FileStatus::operator== (const FileStatus& other) const
@@ -88,10 +489,44 @@ bool FileManager::FileStatus::operator== (const FileStatus& other) const
 
 bool FileManager::FileStatus::refreshFromDisk()
 {
-    auto last = *this;
+    auto lastExisted = existed;
+    auto lastModified = modified;
+    auto lastSize = size;
     existed = file.existsAsFile();
     modified = file.getLastModificationTime();
-    return last.existed != existed || last.modified != modified;
+    size = file.getSize();
+
+    if (lastExisted != existed || lastModified != modified || lastSize != size)
+    {
+        changedAt = Time::getMillisecondCounter();
+
+        if (! pending)
+            pendingSince = changedAt;
+
+        pending = true;
+        return true;
+    }
+    return false;
+}
+
+bool FileManager::FileStatus::isAppendOnly() const
+{
+    return reportedExisted && existed && size > reportedSize;
+}
+
+bool FileManager::FileStatus::needsContentHash() const
+{
+    return existed && (! hasContentHash || hashedFileSize != size || hashedModified != modified);
+}
+
+void FileManager::FileStatus::markReported()
+{
+    grew = isAppendOnly();
+    pending = false;
+    reportedSize = size;
+    reportedExisted = existed;
+    reportedHash = content.hash;
+    hasReportedHash = hasContentHash && ! needsContentHash();
 }
 
 
@@ -100,14 +535,178 @@ bool FileManager::FileStatus::refreshFromDisk()
 // ============================================================================
 void FileManager::timerCallback()
 {
-    pollForChanges();
+    if (! isWatchingAllFiles)
+        pollForChanges();
+
+    reportSettledChanges();
+    updateTimer();
+}
+
+/**
+ Refresh the files named by the watcher. If it has stopped watching a
+ directory, the directories are watched again, which falls back to polling if
+ one of them can no longer be watched, and every file is refreshed, since
+ events may have been missed.
+ */
+void FileManager::handleAsyncUpdate()
+{
+    takeContentHashes();
+
+    if (watcher != nullptr)
+    {
+        auto overflowed = false;
+        auto lostDirectory = false;
+        auto changedFiles = watcher->takeChangedFiles (overflowed, lostDirectory);
+
+        if (lostDirectory)
+            updateWatchedDirectories();
+
+        for (auto& status : statuses)
+            if (overflowed || lostDirectory || changedFiles.contains (status.file.getFullPathName()))
+                status.refreshFromDisk();
+    }
+    updateTimer();
 }
 
 void FileManager::pollForChanges()
 {
     for (auto& status : statuses)
-        if (status.refreshFromDisk())
-            listeners.call (&Listener::fileManagerFileChangedOnDisk, status.file);
+        status.refreshFromDisk();
+}
+
+/**
+ Report the files that have gone the settle time without changing. Each is
+ checked once more before it is reported, and is left pending if it is still
+ being written. A file that has only been appended to is reported anyway once
+ its change has been pending for maxSettleTimesForAppends settle times, so
+ that a file written more often than the settle time can still be followed.
+
+ With content verification, a file whose size and existence are as last
+ reported stays pending until the hasher has hashed it as it is now, and is
+ only reported if its hash differs. A file whose size changed is reported
+ without waiting, and hashed afterwards for the next comparison.
+ */
+void FileManager::reportSettledChanges()
+{
+    auto now = Time::getMillisecondCounter();
+    auto changedFiles = Array<File>();
+
+    for (auto& status : statuses)
+    {
+        if (! status.pending)
+            continue;
+
+        auto isOverdue = now - status.pendingSince >= uint32 (settleTime * maxSettleTimesForAppends);
+
+        if (now - status.changedAt < uint32 (settleTime) && ! isOverdue)
+            continue;
+
+        if (status.refreshFromDisk() && ! (isOverdue && status.isAppendOnly()))
+            continue;
+
+        auto mustCompareContent = shouldVerifyContent
+        && status.hasReportedHash
+        && status.existed == status.reportedExisted
+        && status.size == status.reportedSize;
+
+        if (mustCompareContent && status.needsContentHash())
+        {
+            requestContentHash (status);
+            continue;
+        }
+
+        if (! mustCompareContent || status.content.hash != status.reportedHash)
+        {
+            status.markReported();
+            changedFiles.add (status.file);
+
+            if (shouldVerifyContent)
+                requestContentHash (status);
+        }
+        else
+        {
+            status.pending = false;
+        }
+    }
+
+    for (const auto& file : changedFiles)
+        listeners.call (&Listener::fileManagerFileChangedOnDisk, file);
+}
+
+/**
+ Queue a hash of the file's content as it is now, unless one is already
+ queued or the hash is current.
+ */
+void FileManager::requestContentHash (FileStatus& status)
+{
+    if (status.hashing || ! status.needsContentHash())
+        return;
+
+    auto request = ContentHasher::Request();
+    request.file = status.file;
+    request.size = status.size;
+    request.modified = status.modified;
+    request.previous = status.hasContentHash ? status.content : ContentHash();
+    status.hashing = true;
+    hasher->request (request);
+}
+
+/**
+ Store the hashes the hasher has finished. A hash is of the file as it was
+ when it was requested, so it is only current if the file has not changed
+ since. A file with no reported hash, as when it was just added, takes an
+ unchanged file's hash as the one to compare later hashes against.
+ */
+void FileManager::takeContentHashes()
+{
+    for (const auto& result : hasher->takeResults())
+    {
+        for (auto& status : statuses)
+        {
+            if (status.file != result.request.file)
+                continue;
+
+            status.hashing = false;
+            status.content = result.content;
+            status.hashedFileSize = result.request.size;
+            status.hashedModified = result.request.modified;
+            status.hasContentHash = true;
+
+            if (! status.refreshFromDisk() && ! status.pending && ! status.hasReportedHash && ! status.needsContentHash())
+            {
+                status.reportedHash = status.content.hash;
+                status.hasReportedHash = true;
+            }
+        }
+    }
+}
+
+void FileManager::updateWatchedDirectories()
+{
+    auto directories = Array<File>();
+
+    for (const auto& status : statuses)
+        directories.addIfNotAlreadyThere (status.file.getParentDirectory());
+
+    isWatchingAllFiles = watcher && watcher->setDirectories (directories);
+    updateTimer();
+}
+
+/**
+ Run the timer if files are being polled, or if a change is waiting to
+ settle, and otherwise stop it.
+ */
+void FileManager::updateTimer()
+{
+    auto anyPending = std::any_of (statuses.begin(), statuses.end(), [] (const FileStatus& status) { return status.pending; });
+    auto settleInterval = jmax (10, settleTime / 4);
+
+    if (! isWatchingAllFiles)
+        startTimer (anyPending ? jmin (pollingInterval, settleInterval) : pollingInterval);
+    else if (anyPending)
+        startTimer (settleInterval);
+    else
+        stopTimer();
 }
 
 FileManager::FileStatus FileManager::getStatusForFile (File file) const
@@ -5,7 +5,23 @@
 
 
 // ============================================================================
-class FileManager : private Timer
+/**
+Tracks a list of files, and notifies listeners when any of them changes on
+disk. On Linux the directories holding the files are watched with inotify on
+a background thread, so changes are reported as they happen and nothing is
+done while the files are idle. Elsewhere, or if a directory cannot be
+watched, the files are polled on a timer instead.
+
+A change is reported once the file has gone a settle time without changing
+further, so a file written in many small pieces is reported once, after it is
+complete. A file that keeps growing is reported at least every few settle
+times while it does, so that appended rows are seen as they are written. With
+content verification enabled, a change is also only reported if the file's
+size or content hash differs from when it was last reported. Content is hashed
+on a background thread, and a file that has only grown is hashed by reading
+the appended bytes alone.
+*/
+class FileManager : private Timer, private AsyncUpdater
 {
 public:
     // ========================================================================
@@ -18,9 +34,25 @@ public:
 
     // ========================================================================
     FileManager();
+    ~FileManager();
     void addListener (Listener* listener);
     void removeListener (Listener* listener);
+
+    /** Set the interval at which files are polled when they cannot be
+        watched for changes.
+     */
     void setPollingInterval (int millisecondsBetweenPolling);
+
+    /** Set how long a file must go unchanged before a change to it is
+        reported.
+     */
+    void setSettleTime (int milliseconds);
+
+    /** Enable or disable checking that a file's content has changed before
+        reporting a change, so that rewriting a file with identical bytes
+        does not cause it to be reloaded.
+     */
+    void setContentVerification (bool shouldVerifyContent);
     void setUniqueKey (const String& filename, const std::string& key);
     void addFile (File);
     void removeFile (File);
@@ -29,24 +61,73 @@ public:
     Array<File> getFiles() const;
     std::string getUniqueKey (const String& filename) const;
 
+    /** Return true if the most recent change to the given file only increased its
+        size, as happens when rows are appended to a log file.
+     */
+    bool wasAppendedTo (File file) const;
+
 private:
     // ========================================================================
+    /** The FNV-1a hash of the first size bytes of a file, and of the last
+        64 KB of them, which is checked to tell an append from a rewrite.
+     */
+    struct ContentHash
+    {
+        int64 size = 0;
+        uint64 hash = 0;
+        uint64 tailHash = 0;
+    };
+
     struct FileStatus
     {
         FileStatus();
         FileStatus (File file);
         bool operator== (const FileStatus& other) const;
         bool refreshFromDisk(); /**< Updates the status and returns true if there was a change. */
+        bool isAppendOnly() const; /**< Returns true if the file has only grown since it was last reported. */
+        bool needsContentHash() const; /**< Returns true if the file exists and its content hash is not of its current size and modification time. */
+        bool contentDiffers() const; /**< Returns true if the content differs from when it was last reported. */
+        void markReported(); /**< Records the current status as the one last reported to listeners. */
         File file;
         Time modified;
+        int64 size = 0;
         bool existed = false;
+        bool grew = false;
+        bool pending = false;
+        uint32 changedAt = 0;
+        uint32 pendingSince = 0;
+        int64 reportedSize = 0;
+        bool reportedExisted = false;
+        uint64 reportedHash = 0;
+        bool hasReportedHash = false;
+        ContentHash content;
+        int64 hashedFileSize = 0;
+        Time hashedModified;
+        bool hasContentHash = false;
+        bool hashing = false;
         std::string uniqueKey;
     };
 
+    class DirectoryWatcher;
+    class ContentHasher;
+
     void timerCallback() override;
+    void handleAsyncUpdate() override;
     void pollForChanges();
+    void reportSettledChanges();
+    void requestContentHash (FileStatus& status);
+    void takeContentHashes();
+    void updateWatchedDirectories();
+    void updateTimer();
     FileStatus getStatusForFile (File file) const;
 
     Array<FileStatus> statuses;
     ListenerList<Listener> listeners;
+    std::unique_ptr<DirectoryWatcher> watcher;
+    std::unique_ptr<ContentHasher> hasher;
+    int pollingInterval = 1000;
+    int settleTime = 200;
+    static const int maxSettleTimesForAppends = 5;
+    bool isWatchingAllFiles = false;
+    bool shouldVerifyContent = false;
 };
@@ -0,0 +1,327 @@
+#include "FitsFile.hpp"
+#include "ElementType.hpp"
+#include "Loaders.hpp"
+#include "NumericData.hpp"
+using namespace mcl;
+
+
+
+
+// ============================================================================
+static const int64 blockSize = 2880;
+static const int cardSize = 80;
+
+/**
+ A header and data unit: the header cards by keyword, with string values
+ unquoted, and the location of the data unit in the file.
+ */
+struct Hdu
+{
+    std::map<std::string, std::string> cards;
+    int64 dataOffset = 0;
+    int64 dataSize = 0;
+
+    bool has (const std::string& key) const
+    {
+        return cards.count (key);
+    }
+
+    std::string getString (const std::string& key, const std::string& defaultValue="") const
+    {
+        auto card = cards.find (key);
+        return card == cards.end() ? defaultValue : card->second;
+    }
+
+    int64 getInt (const std::string& key) const
+    {
+        auto card = cards.find (key);
+
+        if (card == cards.end())
+            throw std::runtime_error ("FITS header is missing " + key);
+
+        return std::strtoll (card->second.c_str(), nullptr, 10);
+    }
+
+    int64 getInt (const std::string& key, int64 defaultValue) const
+    {
+        return has (key) ? getInt (key) : defaultValue;
+    }
+
+    double getDouble (const std::string& key, double defaultValue) const
+    {
+        return has (key) ? std::strtod (getString (key).c_str(), nullptr) : defaultValue;
+    }
+};
+
+static std::string trim (const char* begin, const char* end)
+{
+    while (begin != end && *begin == ' ')
+        ++begin;
+    while (end != begin && end[-1] == ' ')
+        --end;
+    return std::string (begin, end);
+}
+
+/**
+ Parse the value field of a card: a quoted string, in which '' is an escaped
+ quote, or anything else up to the comment.
+ */
+static std::string parseValue (const char* c, const char* end)
+{
+    while (c != end && *c == ' ')
+        ++c;
+
+    if (c != end && *c == '\'')
+    {
+        auto value = std::string();
+
+        for (++c; c != end; ++c)
+        {
+            if (*c == '\'')
+            {
+                if (c + 1 != end && c[1] == '\'')
+                    ++c;
+                else
+                    break;
+            }
+            value.push_back (*c);
+        }
+        return trim (value.data(), value.data() + value.size());
+    }
+    auto comment = std::find (c, end, '/');
+    return trim (c, comment);
+}
+
+static std::vector<Hdu> readHdus (const char* data, int64 size)
+{
+    auto hdus = std::vector<Hdu>();
+    auto position = int64 (0);
+
+    while (position + blockSize <= size)
+    {
+        if (! hdus.empty() && std::strncmp (data + position, "XTENSION", 8) != 0)
+            break;
+
+        if (hdus.empty() && std::strncmp (data + position, "SIMPLE  ", 8) != 0)
+            throw std::runtime_error ("not a FITS file");
+
+        auto hdu = Hdu();
+        auto foundEnd = false;
+
+        while (! foundEnd)
+        {
+            if (position + blockSize > size)
+                throw std::runtime_error ("FITS header is truncated");
+
+            for (int n = 0; n < blockSize / cardSize && ! foundEnd; ++n)
+            {
+                auto card = data + position + n * cardSize;
+                auto keyword = trim (card, card + 8);
+
+                if (keyword == "END")
+                    foundEnd = true;
+                else if (card[8] == '=' && card[9] == ' ')
+                    hdu.cards[keyword] = parseValue (card + 10, card + cardSize);
+            }
+            position += blockSize;
+        }
+
+        auto numAxes = hdu.getInt ("NAXIS");
+        auto numElements = int64 (numAxes > 0 ? 1 : 0);
+
+        for (int n = 1; n <= numAxes; ++n)
+            numElements *= hdu.getInt ("NAXIS" + std::to_string (n));
+
+        hdu.dataOffset = position;
+        hdu.dataSize = std::abs (hdu.getInt ("BITPIX")) / 8 * hdu.getInt ("GCOUNT", 1) * (hdu.getInt ("PCOUNT", 0) + numElements);
+
+        if (hdu.dataOffset + hdu.dataSize > size)
+            throw std::runtime_error ("FITS data unit is truncated");
+
+        position += (hdu.dataSize + blockSize - 1) / blockSize * blockSize;
+        hdus.push_back (hdu);
+    }
+
+    if (hdus.empty())
+        throw std::runtime_error ("not a FITS file");
+
+    return hdus;
+}
+
+/**
+ Return an array of count big-endian elements, spaced stride bytes apart, that
+ is converted and scaled when it is first accessed, keeping the file's data
+ alive until then; or at once, if the data must be copied.
+ */
+static Object mappedArray (const Loaders::FileData& bytes,
+                           const char* start,
+                           std::size_t stride,
+                           std::size_t count,
+                           ElementType type,
+                           double scale,
+                           double zero)
+{
+    auto owner = bytes.owner;
+    auto convert = [owner, start, stride, count, type, scale, zero]
+    {
+        auto array = nd::ndarray<double, 1> (int (count));
+
+        if (count > 0)
+        {
+            auto values = &array(0);
+            type.convert (start, stride, values, count);
+
+            if (scale != 1.0 || zero != 0.0)
+                for (std::size_t i = 0; i < count; ++i)
+                    values[i] = zero + scale * values[i];
+        }
+        return array;
+    };
+    if (bytes.mustCopy)
+    {
+        return Object::data (std::make_shared<ArrayDouble1> (convert()));
+    }
+    return Object::data (std::make_shared<ArrayDouble1> (count, convert));
+}
+
+static std::string elementName (int64 bitpix)
+{
+    switch (bitpix)
+    {
+        case   8: return "u8";
+        case  16: return "i16";
+        case  32: return "i32";
+        case  64: return "i64";
+        case -32: return "f32";
+        case -64: return "f64";
+        default: throw std::runtime_error ("FITS header has a bad BITPIX");
+    }
+}
+
+static Object loadImage (const Loaders::FileData& bytes, const Hdu& hdu)
+{
+    auto start = bytes.data + hdu.dataOffset;
+    auto type = ElementType::fromName (elementName (hdu.getInt ("BITPIX")), "big");
+    auto shape = Object::List();
+    auto count = int64 (hdu.getInt ("NAXIS") > 0 ? 1 : 0);
+
+    for (int n = 1; n <= hdu.getInt ("NAXIS"); ++n)
+    {
+        auto extent = hdu.getInt ("NAXIS" + std::to_string (n));
+        shape.push_back (int (extent));
+        count *= extent;
+    }
+
+    auto result = Object::Dict();
+    auto data = mappedArray (bytes, start, type.size, count, type, hdu.getDouble ("BSCALE", 1.0), hdu.getDouble ("BZERO", 0.0));
+    result["data"] = data;
+    result["shape"] = shape;
+
+    if (shape.size() > 1)
+    {
+        // NAXIS1 varies fastest, so in row-major order the axes are reversed.
+        auto extents = std::vector<std::size_t>();
+
+        for (auto extent = shape.rbegin(); extent != shape.rend(); ++extent)
+            extents.push_back (std::size_t (extent->get<int>()));
+
+        auto elements = std::dynamic_pointer_cast<ArrayDouble1> (data.get<Object::Data>().v);
+        result["image"] = Object::data (std::make_shared<ArrayDoubleN> (elements, extents));
+    }
+    return result;
+}
+
+static Object loadBinaryTable (const Loaders::FileData& bytes, const Hdu& hdu)
+{
+    auto start = bytes.data + hdu.dataOffset;
+    auto rowSize = hdu.getInt ("NAXIS1");
+    auto numRows = hdu.getInt ("NAXIS2");
+    auto columns = Object::Dict();
+    auto fieldOffset = int64 (0);
+
+    for (int n = 1; n <= hdu.getInt ("TFIELDS"); ++n)
+    {
+        auto index = std::to_string (n);
+        auto form = hdu.getString ("TFORM" + index);
+        auto name = hdu.getString ("TTYPE" + index, "Col " + std::to_string (n - 1));
+        auto code = std::find_if (form.begin(), form.end(), [] (char c) { return ! std::isdigit (c); });
+        auto repeat = code == form.begin() ? int64 (1) : std::strtoll (form.c_str(), nullptr, 10);
+
+        if (code == form.end())
+            throw std::runtime_error ("FITS header has a bad TFORM" + index);
+
+        auto typeName = std::string();
+        auto fieldSize = int64 (0);
+
+        switch (*code)
+        {
+            case 'B': typeName = "u8";  fieldSize = repeat; break;
+            case 'I': typeName = "i16"; fieldSize = repeat * 2; break;
+            case 'J': typeName = "i32"; fieldSize = repeat * 4; break;
+            case 'K': typeName = "i64"; fieldSize = repeat * 8; break;
+            case 'E': typeName = "f32"; fieldSize = repeat * 4; break;
+            case 'D': typeName = "f64"; fieldSize = repeat * 8; break;
+            case 'L': case 'A': fieldSize = repeat; break;
+            case 'X': fieldSize = (repeat + 7) / 8; break;
+            case 'C': case 'P': fieldSize = repeat * 8; break;
+            case 'M': case 'Q': fieldSize = repeat * 16; break;
+            default: throw std::runtime_error ("FITS header has a bad TFORM" + index);
+        }
+
+        if (! typeName.empty())
+        {
+            auto type = ElementType::fromName (typeName, "big");
+            auto scale = hdu.getDouble ("TSCAL" + index, 1.0);
+            auto zero = hdu.getDouble ("TZERO" + index, 0.0);
+
+            for (int64 r = 0; r < repeat; ++r)
+            {
+                auto key = repeat == 1 ? name : name + "_" + std::to_string (r);
+                auto field = start + fieldOffset + r * type.size;
+                columns[key] = mappedArray (bytes, field, rowSize, numRows, type, scale, zero);
+            }
+        }
+        fieldOffset += fieldSize;
+    }
+
+    if (fieldOffset > rowSize)
+        throw std::runtime_error ("FITS table fields are wider than NAXIS1");
+
+    return columns;
+}
+
+
+
+
+// ============================================================================
+Object FitsFile::load (const File& file, int index)
+{
+    auto bytes = Loaders::mapFile (file);
+    auto hdus = readHdus (bytes.data, bytes.size);
+
+    if (index < 0)
+    {
+        auto withData = std::find_if (hdus.begin(), hdus.end(), [] (const Hdu& hdu) { return hdu.dataSize > 0; });
+        index = withData == hdus.end() ? 0 : int (withData - hdus.begin());
+    }
+    if (index >= int (hdus.size()))
+    {
+        throw std::runtime_error ("file has " + std::to_string (hdus.size()) + " HDUs");
+    }
+
+    const auto& hdu = hdus[index];
+
+    if (hdu.dataSize == 0)
+    {
+        throw std::runtime_error ("HDU " + std::to_string (index) + " has no data");
+    }
+    auto extension = hdu.getString ("XTENSION", "IMAGE");
+
+    if (extension == "IMAGE")
+        return loadImage (bytes, hdu);
+
+    if (extension == "BINTABLE")
+        return loadBinaryTable (bytes, hdu);
+
+    throw std::runtime_error ("unsupported FITS extension " + extension);
+}
@@ -0,0 +1,30 @@
+#pragma once
+#include "JuceHeader.h"
+#include "Kernel/Object.hpp"
+
+
+
+
+// ============================================================================
+/**
+Reader for FITS files: primary and IMAGE extension arrays, and BINTABLE
+extensions. The file is memory-mapped, and the big-endian data units are
+byte-swapped and converted to double when each array is first accessed, or
+at once if the file is watched for changes (see Loaders::mapFile).
+*/
+class FitsFile
+{
+public:
+    /** Load the given HDU of a file, where 0 is the primary HDU, or the first
+        HDU holding any data if hdu is negative. A binary table is returned
+        as a dict of its numeric columns; a column with a repeat count r > 1
+        gives r arrays, named NAME_0 to NAME_r-1. An image is returned as a
+        dict with its flattened pixel values under "data" and its axis lengths
+        (NAXIS1 first) under "shape"; an image of two or more axes is also
+        given under "image" as an ArrayDoubleN sharing those values, with the
+        axes in row-major order (NAXIS1 last). Throws std::runtime_error if the
+        file is not valid FITS, or the HDU has no data or is of an unsupported
+        type.
+     */
+    static mcl::Object load (const File& file, int hdu=-1);
+};
@@ -1,5 +1,6 @@
 #include <iostream>
 #include "AcyclicGraph.hpp"
+#include "Expression.hpp"
 using namespace mcl;
 
 
@@ -36,7 +37,7 @@ bool AcyclicGraph::insert (const std::string& key, const Object& value, const st
     Node node;
     node.key = key;
     node.abstract = value;
-    node.concrete = resolve (value, node.error);
+    node.concrete = evaluate (node);
     node.incoming = incoming;
     node.outgoing = outgoing;
 
@@ -52,12 +53,13 @@ bool AcyclicGraph::insert (const std::string& key, const Object& value, const st
     return true;
 }
 
-void AcyclicGraph::touch (const std::string& key)
+void AcyclicGraph::touch (const std::string& key, Change change)
 {
     if (! contains (key))
         return;
 
-    mark (key);
+    mark (key, change);
+    nodes.at (key).change = change;
 
     if (listener)
         listener (key, concrete (key));
@@ -188,6 +190,16 @@ const Object& AcyclicGraph::concrete (const std::string& key) const
     return node->second.concrete;
 }
 
+AcyclicGraph::Change AcyclicGraph::change (const std::string& key) const
+{
+    auto node = nodes.find (key);
+
+    if (node == nodes.end())
+        return Change::replaced;
+
+    return node->second.change;
+}
+
 const std::string& AcyclicGraph::error (const std::string& key) const
 {
     static std::string empty;
@@ -300,7 +312,9 @@ bool AcyclicGraph::update (const std::string& key)
     if (! current (node->second.incoming))
         return false;
 
-    node->second.concrete = resolve (node->second.abstract, node->second.error);
+    node->second.concrete = evaluate (node->second);
+    node->second.change = node->second.pending;
+    node->second.pending = Change::replaced;
     dirty.erase (key);
 
     if (listener)
@@ -408,20 +422,129 @@ void AcyclicGraph::throwIfWouldCreateCycle (const std::string& source, const std
     }
 }
 
-void AcyclicGraph::mark (const std::string& key)
+Object AcyclicGraph::evaluate (Node& node) const
+{
+    auto previousError = node.error;
+    auto forgetArguments = [&node] ()
+    {
+        node.arguments.clear();
+        node.argumentData.clear();
+        node.keywords.clear();
+        node.extents.clear();
+    };
+
+    try {
+        auto func = Object::Func();
+        auto args = Object::List();
+        auto kwar = Object::Dict();
+        auto scope = [this] (const std::string& key) { return concrete (key); };
+
+        node.error.clear();
+
+        if (node.abstract.type() != 'E'
+            || ! Expression (node.abstract.expression()).evaluateCall (scope, func, args, kwar))
+        {
+            forgetArguments();
+            return resolve (node.abstract);
+        }
+
+        if (! func.incremental)
+        {
+            forgetArguments();
+            return func.f (args, kwar);
+        }
+
+        auto extents = std::vector<long>();
+        auto result = Object();
+
+        for (const auto& arg : args)
+            extents.push_back (arg.type() == 'U' ? arg.get<Object::Data>().extent() : -1);
+
+        if (node.pending == Change::appended && previousError.empty() && isAppendOf (node, args, kwar, extents))
+            result = func.incremental (node.concrete, args, kwar, node.extents);
+
+        if (result.empty())
+            result = func.f (args, kwar);
+
+        /*
+         Only scalar arguments are kept, and data arguments are only
+         referenced, so that the node does not hold on to temporaries such as
+         the product in (sum (mul x y)). A temporary is a new object on every
+         evaluation, so it is never the same data when the node is updated.
+         */
+        forgetArguments();
+
+        for (const auto& arg : args)
+        {
+            node.arguments.push_back (retainedArgument (arg));
+            node.argumentData.push_back (arg.type() == 'U' ? arg.get<Object::Data>().v : nullptr);
+        }
+        for (const auto& kw : kwar)
+        {
+            node.keywords[kw.first] = retainedArgument (kw.second);
+        }
+        node.extents = extents;
+        return result;
+    }
+    catch (std::exception& e)
+    {
+        forgetArguments();
+        node.error = e.what();
+        return Object::None();
+    }
+}
+
+Object AcyclicGraph::retainedArgument (const Object& arg)
+{
+    switch (arg.type())
+    {
+        case 'n': case 'b': case 'i': case 'd': case 'S': return arg;
+        default: return Object::None();
+    }
+}
+
+bool AcyclicGraph::isAppendOf (const Node& node, const Object::List& args, const Object::Dict& kwar, const std::vector<long>& extents)
+{
+    if (args.size() != node.arguments.size() || kwar != node.keywords)
+        return false;
+
+    for (std::size_t n = 0; n < args.size(); ++n)
+    {
+        if (extents[n] == -1)
+        {
+            if (args[n] != node.arguments[n])
+                return false;
+        }
+        else if (node.argumentData[n].lock() != args[n].get<Object::Data>().v
+                 || node.extents[n] > extents[n])
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+void AcyclicGraph::mark (const std::string& key, Change change)
 {
     auto node = nodes.find (key);
 
     if (node != nodes.end())
     {
-        if (! current (key))
+        /*
+         A dirty node is marked again only to downgrade a pending append to a
+         replacement.
+         */
+        if (! current (key) && (change == Change::appended || node->second.pending == Change::replaced))
             return;
 
         if (! node->second.incoming.empty())
+        {
             dirty.insert (key);
+            node->second.pending = change;
+        }
 
         for (const auto& o : node->second.outgoing)
-            mark (o);
+            mark (o, change);
     }
 }
 
@@ -430,8 +553,9 @@ void AcyclicGraph::mark (const std::string& key)
 
 // ============================================================================
 #include <cassert>
-#include "Expression.hpp"
+#include <cmath>
 #include "Builtin.hpp"
+#include "../NumericData.hpp"
 
 void AcyclicGraph::testTopologies()
 {
@@ -491,4 +615,92 @@ void AcyclicGraph::testTopologies()
 
     assert (graph.insert("x", Object::expr ("2.0")));
     assert (graph.concrete ("x").type() == 'd');
+
+    assert (graph.insert ("y", Object::expr ("(add x 1)")));
+    assert (graph.insert ("z", Object::expr ("(add y y)")));
+    graph.touch ("x", Change::appended);
+    assert (graph.change ("y") == Change::appended);
+    assert (graph.change ("z") == Change::appended);
+    graph.touch ("x");
+    assert (graph.change ("z") == Change::replaced);
+}
+
+/**
+ Return true if two results, which are numbers, arrays, or dicts of arrays,
+ are equal to within rounding.
+ */
+static bool resultsAgree (const Object& a, const Object& b)
+{
+    auto agree = [] (double x, double y) { return std::abs (x - y) <= 1e-12 * std::max (1.0, std::abs (y)); };
+
+    if (a.type() == 'd' && b.type() == 'd')
+        return agree (a.get<double>(), b.get<double>());
+
+    if (a.type() == 'D' && b.type() == 'D')
+    {
+        const auto& A = a.get<Object::Dict>();
+        const auto& B = b.get<Object::Dict>();
+
+        for (const auto& item : A)
+            if (! B.count (item.first) || ! resultsAgree (item.second, B.at (item.first)))
+                return false;
+
+        return A.size() == B.size();
+    }
+    if (a.type() == 'U' && b.type() == 'U')
+    {
+        auto A = std::dynamic_pointer_cast<ArrayDouble1> (a.get<Object::Data>().v);
+        auto B = std::dynamic_pointer_cast<ArrayDouble1> (b.get<Object::Data>().v);
+
+        if (! A || ! B || A->size() != B->size())
+            return false;
+
+        for (std::size_t n = 0; n < A->size(); ++n)
+            if (! agree (A->data()[n], B->data()[n]))
+                return false;
+
+        return true;
+    }
+    return false;
+}
+
+void AcyclicGraph::testIncrementalUpdates()
+{
+    AcyclicGraph graph;
+    graph.import (Builtin::arithmetic());
+    graph.import (Builtin::array());
+
+    auto x = std::make_shared<ArrayDouble1> (std::vector<double> { 0.5, 3.0, 1.5, 2.0, 4.0, 1.0 });
+    auto expressions = std::vector<std::string> { "(sum x)", "(mean x)", "(histogram x bins=4)", "(add x x)", "(sum (mul x x))" };
+    auto keys = std::vector<std::string> { "s", "m", "h", "a", "p" };
+
+    assert (graph.insert ("x", Object::data (x)));
+
+    for (std::size_t n = 0; n < keys.size(); ++n)
+        assert (graph.insert (keys[n], Object::expr (expressions[n])));
+
+    auto sum = graph.concrete ("a").get<Object::Data>().v;
+
+    // The appended values lie within the range of the first ones, so that the
+    // histogram's bin edges stay the same.
+    auto tail = std::vector<double> { 2.5, 0.75, 3.5 };
+    x->append (tail.data(), tail.size());
+    graph.touch ("x", Change::appended);
+
+    AcyclicGraph fresh;
+    fresh.import (Builtin::arithmetic());
+    fresh.import (Builtin::array());
+    assert (fresh.insert ("x", Object::data (std::make_shared<ArrayDouble1> (std::vector<double> (x->data(), x->data() + x->size())))));
+
+    for (std::size_t n = 0; n < keys.size(); ++n)
+    {
+        assert (fresh.insert (keys[n], Object::expr (expressions[n])));
+        assert (graph.status (keys[n]).at ("error").empty());
+        assert (resultsAgree (graph.concrete (keys[n]), fresh.concrete (keys[n])));
+    }
+
+    // The elementwise result was extended in place, and the temporary product
+    // in (sum (mul x x)) is not kept alive by its node.
+    assert (graph.concrete ("a").get<Object::Data>().v == sum);
+    assert (graph.nodes.at ("p").argumentData.at (0).expired());
 }
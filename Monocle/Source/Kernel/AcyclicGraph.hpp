@@ -25,6 +25,14 @@ class mcl::AcyclicGraph
 {
 public:
 
+    /** The kind of change that caused a node to be updated. A change is an
+        append if the data at its origin only grew at the end, so that any
+        earlier content remains valid. This is a hint: nodes downstream of an
+        append may inspect their inputs to decide whether they can be updated
+        from the appended part alone.
+     */
+    enum class Change { replaced, appended };
+
     struct Node
     {
         Object abstract;
@@ -33,6 +41,12 @@ public:
         std::string error;
         std::set<std::string> incoming;
         std::set<std::string> outgoing;
+        Change change = Change::replaced;
+        Change pending = Change::replaced;
+        Object::List arguments;    /**< scalar arguments of the last evaluation, kept if the function is incremental; others are None */
+        std::vector<std::weak_ptr<UserData>> argumentData; /**< the data arguments of the last evaluation, which are not kept alive */
+        Object::Dict keywords;     /**< keyword arguments of the last evaluation, kept like the positional ones */
+        std::vector<long> extents; /**< the extent of each of the arguments */
     };
     using Status = std::unordered_map<std::string, std::string>;
     using NodePredicate = std::function<bool (const Node&)>;
@@ -72,9 +86,11 @@ public:
     std::string insert (const Object& item);
 
     /** Trigger an update of any expression downstream of the given symbol, even if the
-        data associated with it has not changed.
+        data associated with it has not changed. If the change is an append, it is
+        recorded as such on all the downstream nodes, unless they are also
+        affected by some other change that replaced data.
      */
-    void touch (const std::string& key);
+    void touch (const std::string& key, Change change=Change::replaced);
 
     /** Generate a random key that does not exist in the graph. */
     std::string nextRandomKey() const;
@@ -111,6 +127,11 @@ public:
      */
     const Object& concrete (const std::string& key) const;
 
+    /** Return the kind of change that caused the most recent update of the given
+        node. Change::replaced is returned if the key does not exist.
+     */
+    Change change (const std::string& key) const;
+
     /** Return the error string associated with the evaluation of a node. */
     const std::string& error (const std::string& key) const;
 
@@ -154,7 +175,10 @@ public:
         The update is only necessary if the node is dirty, and is not possible
         if the node has any dirty upstream nodes. Returns true if the node
         is current after the call. Invokes the listener on the node if it was
-        updated.
+        updated. If the node was marked dirty only by appends, its expression
+        is a call to a function with an incremental form, and its arguments
+        are the same as in the last evaluation except for having grown, then
+        the incremental form is used to update the previous result.
     */
     bool update (const std::string& key);
 
@@ -204,10 +228,18 @@ public:
 
     static void testTopologies();
 
+    /** Check that the results of sum, mean, histogram and add, updated after
+        data is appended to their argument, equal those computed in full.
+     */
+    static void testIncrementalUpdates();
+
 private:
     bool insert (const std::string& key, const Object& value, const std::set<std::string>& incoming);
     bool removeWithoutNotificationOrUpdate (const std::string& key);
-    void mark (const std::string& key);
+    void mark (const std::string& key, Change change=Change::replaced);
+    Object evaluate (Node& node) const;
+    static Object retainedArgument (const Object& arg);
+    static bool isAppendOf (const Node& node, const Object::List& args, const Object::Dict& kwar, const std::vector<long>& extents);
 
     NodeMap nodes;
     NodeSet dirty;
@@ -27,11 +27,75 @@ public:
     /** Return a pack of basic arithmetic functions: add, sub, mul, div, pow. */
     static Object::Dict arithmetic();
 
-    /** Return a pack of all trig functions in the standard library. */
+    /** Return a pack of elementwise math functions: exp, log, log10, log2,
+        sqrt, the trigonometric and hyperbolic functions and their inverses,
+        atan2 and hypot. They return a double for a number, and for an array
+        an array of the same precision. Over arrays, exp, the logarithms, sin,
+        cos and tan are computed by vectorized polynomial approximations (see
+        VectorMath), and appended elements are computed incrementally.
+     */
     static Object::Dict trigonometric();
 
-    /** Return a pack of functions that creates and manipulates arrays. */
+    /** Return a pack of functions that creates and manipulates arrays. The
+        reductions have incremental forms, so they are updated in proportion to
+        the number of elements appended to their argument. Sums are pairwise
+        and cumulative sums compensated, so their rounding error stays small
+        for long arrays. min, max, argmin and argmax ignore NaN values, giving
+        NaN or -1 if there are no others. sort and argsort place NaN values
+        last, and argsort is stable. slice takes start, stop and step as
+        Python does, and take returns the first n elements, or the last -n.
+        Applied to a double array with a step of 1, they return a view that
+        shares its memory, and otherwise a copy. reshape gives the elements of
+        a double array, in memory order, a new shape and order (C or F)
+        without copying them. Elementwise functions of ArrayDoubleN operands
+        keep their shape; the other functions see an ArrayDoubleN as its
+        elements in memory order.
+     */
     static Object::Dict array();
+    static Object sum (const Object::List&, const Object::Dict&);
+    static Object mean (const Object::List&, const Object::Dict&);
+    static Object histogram (const Object::List&, const Object::Dict&);
+    static Object sort (const Object::List&, const Object::Dict&);
+    static Object argsort (const Object::List&, const Object::Dict&);
+    static Object searchsorted (const Object::List&, const Object::Dict&);
+    static Object stddev (const Object::List&, const Object::Dict&);
+    static Object min (const Object::List&, const Object::Dict&);
+    static Object max (const Object::List&, const Object::Dict&);
+    static Object argmin (const Object::List&, const Object::Dict&);
+    static Object argmax (const Object::List&, const Object::Dict&);
+    static Object cumsum (const Object::List&, const Object::Dict&);
+    static Object diff (const Object::List&, const Object::Dict&);
+    static Object linspace (const Object::List&, const Object::Dict&);
+    static Object logspace (const Object::List&, const Object::Dict&);
+    static Object arange (const Object::List&, const Object::Dict&);
+    static Object slice (const Object::List&, const Object::Dict&);
+    static Object take (const Object::List&, const Object::Dict&);
+    static Object reshape (const Object::List&, const Object::Dict&);
+    static Object shape (const Object::List&, const Object::Dict&);
+
+    /** Check the radix sort behind sort and argsort (NaN last, signed zeros,
+        stability, skipped passes, and keys split into several ranges),
+        searchsorted on both sides, and the accuracy of sum and cumsum.
+     */
+    static void testArrayOperations();
+
+    /** Return a pack of functions that select rows of arrays and tables. A
+        mask marks the rows meeting bounds on an array, where turns masks into
+        the indexes of the selected rows, and select gathers those rows from
+        an array or from each array in a dict or list. group-by aggregates the
+        value columns of a table (sum, mean, min, max, count) over the groups
+        of rows with equal keys, in the order the keys first appear. A key
+        column named like an aggregate (count, or value-op) is an error.
+        join-tables pairs the rows of two tables having equal values in a key
+        column (an inner join); right columns whose names are taken in the left
+        table are given the suffix -right.
+     */
+    static Object::Dict query();
+    static Object mask (const Object::List&, const Object::Dict&);
+    static Object where (const Object::List&, const Object::Dict&);
+    static Object select (const Object::List&, const Object::Dict&);
+    static Object group_by (const Object::List&, const Object::Dict&);
+    static Object join_tables (const Object::List&, const Object::Dict&);
 
 
 
@@ -56,6 +120,27 @@ public:
         }
     }
 
+    template<typename T>
+    static T check_kwarg (const Object::Dict& kwar, const std::string& key, const T& defaultValue)
+    {
+        auto item = kwar.find (key);
+
+        if (item == kwar.end())
+        {
+            return defaultValue;
+        }
+        try {
+            return item->second.get<T>();
+        }
+        catch (const mpark::bad_variant_access& e)
+        {
+            throw std::runtime_error ("wrong data type ("
+                                      + std::string (1, item->second.type())
+                                      + ") for keyword "
+                                      + key);
+        }
+    }
+
     template<typename T>
     static T& check_user_data (const Object::List& args, int index)
     {
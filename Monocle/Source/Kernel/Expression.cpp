@@ -76,6 +76,16 @@ Object Expression::evaluate (Object::Scope scope) const
     return root.evaluate (scope);
 }
 
+bool Expression::evaluateCall (Object::Scope scope, Object::Func& func, Object::List& args, Object::Dict& kwar) const
+{
+    if (root.type != 'E' || root.parts.empty())
+    {
+        return false;
+    }
+    root.evaluateCall (scope, func, args, kwar);
+    return true;
+}
+
 std::set<std::string> Expression::symbols() const
 {
     return root.symbols();
@@ -386,37 +396,47 @@ Object Expression::Part::evaluate (Object::Scope scope) const
             {
                 return Object::None();
             }
-            else if (scope (parts.at (0).symbol()).type() != 'F')
-            {
-                throw std::runtime_error ("Expression head is not a function");
-            }
 
-            auto func = scope (parts.at (0).symbol()).get<Object::Func>().f;
+            auto func = Object::Func();
             auto args = Object::List();
             auto kwar = Object::Dict();
-            auto first = true;
 
-            for (const auto& part : parts)
+            evaluateCall (scope, func, args, kwar);
+            return func.f (args, kwar);
+        }
+        default: assert (type == 0); return Object();
+    }
+}
+
+void Expression::Part::evaluateCall (Object::Scope scope, Object::Func& func, Object::List& args, Object::Dict& kwar) const
+{
+    auto head = scope (parts.at (0).symbol());
+
+    if (head.type() != 'F')
+    {
+        throw std::runtime_error ("Expression head is not a function");
+    }
+
+    auto first = true;
+    func = head.get<Object::Func>();
+
+    for (const auto& part : parts)
+    {
+        if (! first)
+        {
+            if (part.kw)
             {
-                if (! first)
-                {
-                    if (part.kw)
-                    {
-                        kwar.emplace (part.keyword(), part.evaluate (scope));
-                    }
-                    else
-                    {
-                        args.push_back (part.evaluate (scope));
-                    }
-                }
-                else
-                {
-                    first = false;
-                }
+                kwar.emplace (part.keyword(), part.evaluate (scope));
+            }
+            else
+            {
+                args.push_back (part.evaluate (scope));
             }
-            return func (args, kwar);
         }
-        default: assert (type == 0); return Object();
+        else
+        {
+            first = false;
+        }
     }
 }
 
@@ -45,6 +45,7 @@ public:
         std::set<std::string> symbols() const;
         Object evaluate (const Object::Dict& scope) const;
         Object evaluate (Object::Scope scope) const;
+        void evaluateCall (Object::Scope scope, Object::Func& func, Object::List& args, Object::Dict& kwar) const;
         Part withKeyword (const char* keyword, size_t len) const;
     };
 
@@ -77,6 +78,13 @@ public:
      */
     Object evaluate (Object::Scope scope) const;
 
+    /** If the expression is a function call, evaluate its head and arguments
+        within the given scope, but do not call the function. Returns false if
+        the expression is not a function call. Throws std::runtime_error if the
+        evaluation fails.
+     */
+    bool evaluateCall (Object::Scope scope, Object::Func& func, Object::List& args, Object::Dict& kwar) const;
+
     /** Return a collection of symbols referenced by the expression.
      */
     std::set<std::string> symbols() const;
@@ -36,11 +36,23 @@ public:
 
     struct Func
     {
+        /** Optional form of a function that updates its previous result after data
+            was appended to its positional arguments. It receives the previous
+            result, the current arguments, and the extent each argument had when
+            the previous result was computed; the appended part of argument n
+            begins at index start[n] (start[n] is -1 for arguments that have no
+            extent). If the result cannot be updated, it returns Object::None and
+            the function is evaluated in full.
+         */
+        using Incremental = std::function<Object (const Object& previous, const List&, const Dict&, const std::vector<long>& start)>;
+
         Func() {}
         Func (std::function<Object (const List&, const Dict&)> f, const std::string& doc="") : f (f), doc (doc) {}
+        Func (std::function<Object (const List&, const Dict&)> f, Incremental incremental, const std::string& doc="") : f (f), incremental (incremental), doc (doc) {}
         bool operator==(const Func& other) const { return false; }
         bool operator!=(const Func& other) const { return true; }
         std::function<Object (const List&, const Dict&)> f = nullptr;
+        Incremental incremental = nullptr;
         std::string doc;
     };
 
@@ -51,6 +63,7 @@ public:
         bool operator==(const Data& other) const { return false; }
         bool operator!=(const Data& other) const { return true; }
         std::string describe() const { return v->describe(); }
+        long extent() const { return v ? v->extent() : -1; }
         std::shared_ptr<UserData> v;
     };
 
@@ -15,4 +15,11 @@ public:
 	virtual std::string describe() const = 0;
 	virtual std::string serialize() const = 0;
     virtual bool load (const std::string&) = 0;
+
+    /** Data that may only grow, by appending elements to its end, return the
+        number of elements they hold. Other data return -1. This allows a
+        function to be updated from the appended part of its arguments only
+        (see Object::Func::incremental).
+     */
+    virtual long extent() const { return -1; }
 };
@@ -0,0 +1,167 @@
+#include "LoadQueue.hpp"
+
+
+
+
+// ============================================================================
+class LoadQueue::Job : public ThreadPoolJob
+{
+public:
+    Job (File file) : ThreadPoolJob ("load " + file.getFileName()), file (file)
+    {
+    }
+
+    JobStatus runJob() override
+    {
+        try {
+            Loaders::loadInBackground (file.getFullPathName().toStdString(), progress);
+        }
+        catch (const std::exception& e)
+        {
+            error = e.what();
+        }
+        finished = true;
+        return jobHasFinished;
+    }
+
+    /** Return the fraction of the file read so far, and an estimate of the
+        time remaining from the rate at which it has been read.
+     */
+    double getFraction (double& secondsRemaining) const
+    {
+        auto total = double (progress.bytesTotal);
+        auto done = double (progress.bytesProcessed);
+        auto elapsed = (Time::getMillisecondCounterHiRes() - startTime) * 1e-3;
+
+        if (total <= 0.0 || done <= 0.0)
+        {
+            secondsRemaining = -1.0;
+            return 0.0;
+        }
+        secondsRemaining = elapsed * (total - done) / done;
+        return done / total;
+    }
+
+    File file;
+    Loaders::Progress progress;
+    String error;
+    std::atomic<bool> finished { false };
+    double startTime = Time::getMillisecondCounterHiRes();
+};
+
+
+
+
+// ============================================================================
+LoadQueue::LoadQueue() : pool (jmax (1, SystemStats::getNumCpus() - 1))
+{
+}
+
+LoadQueue::~LoadQueue()
+{
+    for (auto job : jobs)
+        job->progress.cancelled = true;
+
+    for (auto job : cancelledJobs)
+        job->progress.cancelled = true;
+
+    pool.removeAllJobs (true, -1);
+}
+
+void LoadQueue::addListener (Listener* listener)
+{
+    listeners.add (listener);
+}
+
+void LoadQueue::removeListener (Listener* listener)
+{
+    listeners.remove (listener);
+}
+
+void LoadQueue::startLoading (File file)
+{
+    cancelLoading (file);
+    auto job = jobs.add (new Job (file));
+    pool.addJob (job, false);
+    startTimer (100);
+}
+
+void LoadQueue::cancelLoading (File file)
+{
+    for (int n = jobs.size(); --n >= 0; )
+    {
+        if (jobs[n]->file == file)
+        {
+            jobs[n]->progress.cancelled = true;
+            cancelledJobs.add (jobs.removeAndReturn (n));
+            listeners.call (&Listener::loadQueueProgressChanged, file, -1.0, 0.0);
+        }
+    }
+}
+
+bool LoadQueue::isLoading (File file) const
+{
+    for (auto job : jobs)
+        if (job->file == file)
+            return true;
+
+    return false;
+}
+
+
+
+
+// ============================================================================
+void LoadQueue::timerCallback()
+{
+    auto loadedFiles = Array<File>();
+    auto errors = StringArray();
+    auto loadingFiles = Array<File>();
+    auto fractions = Array<double>();
+    auto secondsRemaining = Array<double>();
+
+    for (int n = cancelledJobs.size(); --n >= 0; )
+    {
+        if (cancelledJobs[n]->finished)
+            removeJob (cancelledJobs, n);
+    }
+
+    for (int n = jobs.size(); --n >= 0; )
+    {
+        if (jobs[n]->finished)
+        {
+            loadedFiles.add (jobs[n]->file);
+            errors.add (jobs[n]->error);
+            removeJob (jobs, n);
+        }
+        else
+        {
+            double seconds;
+            fractions.add (jobs[n]->getFraction (seconds));
+            secondsRemaining.add (seconds);
+            loadingFiles.add (jobs[n]->file);
+        }
+    }
+
+    if (jobs.isEmpty() && cancelledJobs.isEmpty())
+        stopTimer();
+
+    for (int n = 0; n < loadingFiles.size(); ++n)
+        listeners.call (&Listener::loadQueueProgressChanged, loadingFiles[n], fractions[n], secondsRemaining[n]);
+
+    for (int n = 0; n < loadedFiles.size(); ++n)
+    {
+        listeners.call (&Listener::loadQueueProgressChanged, loadedFiles[n], -1.0, 0.0);
+        listeners.call (&Listener::loadQueueFileLoaded, loadedFiles[n], errors[n]);
+    }
+}
+
+/**
+ Remove a job from the pool and delete it. This is only called once the job
+ has finished, so its thread has at most to return from runJob.
+ */
+void LoadQueue::removeJob (OwnedArray<Job>& from, int index)
+{
+    pool.removeJob (from[index], false, -1);
+    from.remove (index);
+}
@@ -0,0 +1,63 @@
+#pragma once
+#include "JuceHeader.h"
+#include "Loaders.hpp"
+
+
+
+
+// ============================================================================
+/**
+Runs background loads of text files on a thread pool. While loads are
+running, a timer reports their progress to the listeners, and tells them when
+each one finishes. A load can be cancelled at any time, in which case the
+listeners are told only that it is no longer in progress.
+*/
+class LoadQueue : private Timer
+{
+public:
+    // ========================================================================
+    class Listener
+    {
+    public:
+        virtual ~Listener() {}
+
+        /** Called while a file is loading, and once more with a negative
+            fraction when the load has finished or been cancelled.
+         */
+        virtual void loadQueueProgressChanged (File file, double fraction, double secondsRemaining) = 0;
+
+        /** Called when the load of a file has finished. The error is empty if
+            the load succeeded, in which case load-txt on the file returns the
+            columns that were read.
+         */
+        virtual void loadQueueFileLoaded (File file, const String& error) = 0;
+    };
+
+    // ========================================================================
+    LoadQueue();
+    ~LoadQueue();
+    void addListener (Listener* listener);
+    void removeListener (Listener* listener);
+
+    /** Start loading a file, cancelling any load of it that is running. */
+    void startLoading (File file);
+
+    /** Cancel the load of a file, if one is running. This returns at once;
+        the load stops when it next checks for cancellation, and its job is
+        deleted once it has.
+     */
+    void cancelLoading (File file);
+    bool isLoading (File file) const;
+
+private:
+    // ========================================================================
+    class Job;
+
+    void timerCallback() override;
+    void removeJob (OwnedArray<Job>& from, int index);
+
+    ThreadPool pool;
+    OwnedArray<Job> jobs;
+    OwnedArray<Job> cancelledJobs;
+    ListenerList<Listener> listeners;
+};
@@ -1,42 +1,1165 @@
-#include <fstream>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <set>
+#include <thread>
+#include "JuceHeader.h"
 #include "Loaders.hpp"
 #include "AsciiLoader.hpp"
+#include "ColumnCache.hpp"
+#include "CsvLoader.hpp"
+#include "Database.hpp"
+#include "ElementType.hpp"
+#include "FitsFile.hpp"
+#include "NpyFile.hpp"
 #include "NumericData.hpp"
 #include "Kernel/Builtin.hpp"
+#include "Numerical/Parallel.hpp"
 using namespace mcl;
 
 
 
 
 //==============================================================================
-Object Loaders::load_txt (const Object::List& args, const Object::Dict&)
+/*
+ State kept for each file loaded with follow=1: the offset just past the last
+ complete line that was parsed, hashes of the leading bytes and of the bytes
+ ending at that offset (used to detect that the file was rewritten rather than
+ appended to, even if it was rewritten with the same header and first rows),
+ and the arrays that are extended in place as rows are appended to the file. A
+ partially written last line is not consumed, so it is parsed in full on the
+ next load.
+ */
+struct FollowedFile
+{
+    int64 offset = 0;
+    uint64 leadingHash = 0;
+    uint64 trailingHash = 0;
+    std::vector<std::string> names;
+    std::vector<std::shared_ptr<ArrayDouble1>> arrays;
+};
+
+static std::map<std::string, FollowedFile> followedFiles;
+static const int64 numLeadingBytesToHash = 4096;
+static const int64 numTrailingBytesToHash = 4096;
+static const int64 numVersionBytesToHash = 65536;
+
+static uint64 hashBytes (const char* data, int64 size, uint64 hash=14695981039346656037ull)
+{
+    for (int64 n = 0; n < size; ++n)
+    {
+        hash ^= uint8 (data[n]);
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+/**
+ Return the hash of the bytes just before the given offset, which are the last
+ ones parsed by a follow.
+ */
+static uint64 hashBytesBefore (const char* begin, int64 offset)
+{
+    auto size = std::min (offset, numTrailingBytesToHash);
+    return hashBytes (begin + offset - size, size);
+}
+
+static Object follow (const std::string& key, const char* begin, const char* end)
+{
+    auto& followed = followedFiles[key];
+    auto size = int64 (end - begin);
+    auto isAppended = followed.offset > 0
+    && followed.offset <= size
+    && followed.leadingHash == hashBytes (begin, std::min (followed.offset, numLeadingBytesToHash))
+    && followed.trailingHash == hashBytesBefore (begin, followed.offset);
+
+    if (isAppended)
+    {
+        AsciiLoader loader (begin + followed.offset, end, followed.names);
+
+        if (! loader.getStatusMessage().empty())
+        {
+            throw std::runtime_error (loader.getStatusMessage());
+        }
+        for (int n = 0; n < loader.getNumColumns() && loader.getNumRows() > 0; ++n)
+        {
+            auto column = loader.takeColumnData (n);
+            followed.arrays[n]->append (&column(0), loader.getNumRows());
+        }
+        followed.offset += loader.getNumBytesParsed();
+    }
+    else
+    {
+        AsciiLoader loader (begin, end, true);
+
+        if (! loader.getStatusMessage().empty())
+        {
+            throw std::runtime_error (loader.getStatusMessage());
+        }
+        followed = FollowedFile();
+        followed.names = loader.getColumnNames();
+        followed.offset = loader.getNumBytesParsed();
+
+        for (int n = 0; n < loader.getNumColumns(); ++n)
+        {
+            followed.arrays.push_back (std::make_shared<ArrayDouble1> (loader.takeColumnData (n)));
+        }
+    }
+    followed.leadingHash = hashBytes (begin, std::min (followed.offset, numLeadingBytesToHash));
+    followed.trailingHash = hashBytesBefore (begin, followed.offset);
+
+    auto columns = Object::dict();
+
+    for (int n = 0; n < followed.names.size(); ++n)
+    {
+        columns[followed.names[n]] = Object::data (followed.arrays[n]);
+    }
+    return columns;
+}
+
+/**
+ Identify the version of a source file for the column cache. Hashing the whole
+ file would cost about as much as parsing it, so only the first and last blocks
+ are hashed; together with the size and modification time this catches edits
+ in practice.
+ */
+static ColumnCache::SourceVersion getSourceVersion (const File& file, const char* begin, const char* end)
+{
+    auto size = int64 (end - begin);
+    auto block = std::min (size, numVersionBytesToHash);
+
+    ColumnCache::SourceVersion version;
+    version.size = size;
+    version.modified = file.getLastModificationTime().toMilliseconds();
+    version.hash = hashBytes (end - block, block, hashBytes (begin, block));
+    return version;
+}
+
+
+
+
+/**
+ A bounded queue of decompressed chunks, passed from the decompressing thread
+ to the parsing one. The producer blocks while the queue is full, so at most a
+ few chunks of the decompressed text are in memory at once.
+ */
+class ChunkQueue
+{
+public:
+    /** Add a chunk, blocking while the queue is full. Returns false if the
+        consumer has cancelled, in which case the producer should stop.
+     */
+    bool push (std::string chunk)
+    {
+        std::unique_lock<std::mutex> lock (mutex);
+        notFull.wait (lock, [this] { return chunks.size() < capacity || cancelled; });
+
+        if (cancelled)
+            return false;
+
+        chunks.push_back (std::move (chunk));
+        notEmpty.notify_one();
+        return true;
+    }
+
+    /** Take the next chunk, blocking until there is one. Returns false once
+        the producer has finished and the queue is empty.
+     */
+    bool pop (std::string& chunk)
+    {
+        std::unique_lock<std::mutex> lock (mutex);
+        notEmpty.wait (lock, [this] { return ! chunks.empty() || finished; });
+
+        if (chunks.empty())
+            return false;
+
+        chunk = std::move (chunks.front());
+        chunks.pop_front();
+        notFull.notify_one();
+        return true;
+    }
+
+    void finish()
+    {
+        std::lock_guard<std::mutex> lock (mutex);
+        finished = true;
+        notEmpty.notify_one();
+    }
+
+    void cancel()
+    {
+        std::lock_guard<std::mutex> lock (mutex);
+        cancelled = true;
+        notFull.notify_one();
+    }
+
+private:
+    static const std::size_t capacity = 4;
+    std::deque<std::string> chunks;
+    std::mutex mutex;
+    std::condition_variable notEmpty;
+    std::condition_variable notFull;
+    bool finished = false;
+    bool cancelled = false;
+};
+
+static bool isGzipped (const char* begin, const char* end)
+{
+    return end - begin >= 2 && uint8 (begin[0]) == 0x1f && uint8 (begin[1]) == 0x8b;
+}
+
+/**
+ Parse text that arrives in chunks from a decompressor, without holding all of
+ it at once. The complete lines of each chunk are parsed as they arrive and
+ appended to the columns, and a partial last line is carried over to the next
+ chunk. Parsing the first chunk is deferred until it holds a data row, so that
+ the header is read as it would be from the whole text. If a progress is given
+ and it is cancelled, an exception is thrown and the rows read so far are
+ freed.
+ */
+static void parseChunks (std::function<bool (std::string&)> nextChunk,
+                         std::vector<std::string>& names,
+                         std::vector<std::shared_ptr<ArrayDouble1>>& arrays,
+                         Loaders::Progress* progress)
+{
+    auto columns = std::vector<std::shared_ptr<ArrayDouble1>>();
+    auto pending = std::string();
+    auto chunk = std::string();
+    auto headerRead = false;
+    auto numLinesParsed = 0ul;
+    auto more = true;
+
+    while (more)
+    {
+        if (progress && progress->cancelled)
+        {
+            throw std::runtime_error ("load cancelled");
+        }
+        more = nextChunk (chunk);
+        pending += chunk;
+        chunk.clear();
+
+        if (! more && ! pending.empty() && pending.back() != '\n')
+        {
+            pending += '\n';
+        }
+        auto begin = pending.data();
+        auto end = begin + pending.size();
+        auto loader = headerRead ? AsciiLoader (begin, end, names) : AsciiLoader (begin, end, true);
+
+        if (! loader.getStatusMessage().empty())
+        {
+            throw std::runtime_error ("Missing data on line " + std::to_string (numLinesParsed + loader.getErrorLine()));
+        }
+        if (! headerRead && loader.getNumRows() == 0 && more)
+        {
+            continue;
+        }
+        if (! headerRead)
+        {
+            names = loader.getColumnNames();
+
+            for (int n = 0; n < names.size(); ++n)
+                columns.push_back (std::make_shared<ArrayDouble1>());
+
+            headerRead = true;
+        }
+        for (int n = 0; n < loader.getNumColumns() && loader.getNumRows() > 0; ++n)
+        {
+            auto column = loader.takeColumnData (n);
+            columns[n]->append (&column(0), loader.getNumRows());
+        }
+        numLinesParsed += std::count (begin, begin + loader.getNumBytesParsed(), '\n');
+        pending.erase (0, loader.getNumBytesParsed());
+    }
+    arrays.insert (arrays.end(), columns.begin(), columns.end());
+}
+
+/**
+ Return the CRC-32 of the given bytes, continuing from a previous value, as
+ recorded in the trailer of a gzip file.
+ */
+static uint32 updateCrc32 (uint32 crc, const char* data, std::size_t size)
+{
+    static const auto table = []
+    {
+        auto entries = std::vector<uint32> (256);
+
+        for (uint32 n = 0; n < 256; ++n)
+        {
+            auto c = n;
+
+            for (int k = 0; k < 8; ++k)
+                c = c & 1 ? 0xedb88320u ^ (c >> 1) : c >> 1;
+
+            entries[n] = c;
+        }
+        return entries;
+    }();
+
+    crc = ~crc;
+
+    for (std::size_t n = 0; n < size; ++n)
+        crc = table[(crc ^ uint8 (data[n])) & 0xff] ^ (crc >> 8);
+
+    return ~crc;
+}
+
+/**
+ Parse a gzip-compressed text file without writing or holding the decompressed
+ text. One thread decompresses the file in chunks while this one parses them
+ as they arrive. The decompressor stops quietly at the end of a truncated or
+ corrupt stream, so the CRC and length of the text are checked against the
+ gzip trailer once it has finished.
+ */
+static void loadGzipped (const File& file,
+                         std::vector<std::string>& names,
+                         std::vector<std::shared_ptr<ArrayDouble1>>& arrays,
+                         Loaders::Progress* progress=nullptr)
+{
+    const int chunkSize = 1 << 20;
+    ChunkQueue queue;
+    auto reachedEnd = false;
+    auto isComplete = false;
+
+    std::thread decompressor ([&queue, &reachedEnd, &isComplete, file, chunkSize, progress]
+    {
+        auto source = new FileInputStream (file);
+        GZIPDecompressorInputStream stream (source, true, GZIPDecompressorInputStream::gzipFormat);
+        auto crc = uint32 (0);
+        auto length = uint32 (0);
+        reachedEnd = true;
+
+        while (! stream.isExhausted())
+        {
+            auto chunk = std::string (chunkSize, '\0');
+            auto numRead = stream.read (&chunk[0], chunkSize);
+
+            if (numRead <= 0)
+                break;
+
+            chunk.resize (numRead);
+            crc = updateCrc32 (crc, chunk.data(), chunk.size());
+            length += uint32 (numRead);
+
+            if (progress)
+                progress->bytesProcessed = source->getPosition();
+
+            if (! queue.push (std::move (chunk)))
+            {
+                reachedEnd = false;
+                break;
+            }
+        }
+
+        if (reachedEnd)
+        {
+            char trailer[8];
+            FileInputStream input (file);
+            isComplete = file.getSize() >= 18
+            && input.setPosition (file.getSize() - 8)
+            && input.read (trailer, 8) == 8
+            && ByteOrder::littleEndianInt (trailer) == crc
+            && ByteOrder::littleEndianInt (trailer + 4) == length;
+        }
+        queue.finish();
+    });
+
+    auto truncated = std::runtime_error (file.getFileName().toStdString() + " is truncated or corrupt");
+
+    try {
+        parseChunks ([&queue] (std::string& chunk) { return queue.pop (chunk); }, names, arrays, progress);
+        decompressor.join();
+    }
+    catch (...)
+    {
+        queue.cancel();
+        decompressor.join();
+
+        // A partial last line is reported as missing data, but is a symptom
+        // of the stream ending early.
+        if (reachedEnd && ! isComplete)
+            throw truncated;
+
+        throw;
+    }
+
+    if (! isComplete)
+    {
+        arrays.clear();
+        throw truncated;
+    }
+}
+
+
+
+
+//==============================================================================
+/*
+ Columns read by a background load, which are returned in place of reading the
+ file by the next load-txt of it with no keywords, as long as the file's size
+ and modification time are those it had when the load started. Any load-txt of
+ the file discards them, since a symbol loading it some other way would never
+ use them. Background loads write this map, and the kernel reads it, from
+ different threads.
+ */
+struct StagedColumns
+{
+    int64 size = 0;
+    int64 modified = 0;
+    Object columns;
+};
+
+static std::map<std::string, StagedColumns> stagedFiles;
+static std::mutex stagedFilesMutex;
+
+static Object takeStagedColumns (const File& file)
+{
+    std::lock_guard<std::mutex> lock (stagedFilesMutex);
+    auto staged = stagedFiles.find (file.getFullPathName().toStdString());
+
+    if (staged == stagedFiles.end())
+    {
+        return Object();
+    }
+    auto isCurrent = staged->second.size == file.getSize()
+    && staged->second.modified == file.getLastModificationTime().toMilliseconds();
+    auto columns = isCurrent ? staged->second.columns : Object();
+
+    stagedFiles.erase (staged);
+    return columns;
+}
+
+
+
+
+//==============================================================================
+static std::set<std::string> watchedFiles;
+static std::mutex watchedFilesMutex;
+
+static bool isWatchedFile (const File& file)
+{
+    std::lock_guard<std::mutex> lock (watchedFilesMutex);
+    return watchedFiles.count (file.getFullPathName().toStdString()) > 0;
+}
+
+Loaders::FileData Loaders::mapFile (const File& file)
+{
+    auto mapped = std::make_shared<MemoryMappedFile> (file, MemoryMappedFile::readOnly);
+    auto bytes = FileData();
+    bytes.data = static_cast<const char*> (mapped->getData());
+    bytes.size = bytes.data ? int64 (mapped->getSize()) : 0;
+    bytes.owner = mapped;
+    bytes.mustCopy = isWatchedFile (file);
+    return bytes;
+}
+
+Loaders::FileData Loaders::readFile (const File& file)
+{
+    if (! isWatchedFile (file))
+    {
+        return mapFile (file);
+    }
+    auto block = std::make_shared<MemoryBlock>();
+
+    if (! file.loadFileAsData (*block))
+    {
+        throw std::runtime_error ("could not read " + file.getFullPathName().toStdString());
+    }
+    auto bytes = FileData();
+    bytes.data = static_cast<const char*> (block->getData());
+    bytes.size = bytes.data ? int64 (block->getSize()) : 0;
+    bytes.owner = block;
+    return bytes;
+}
+
+void Loaders::setWatchedFiles (const Array<File>& files)
+{
+    std::lock_guard<std::mutex> lock (watchedFilesMutex);
+    watchedFiles.clear();
+
+    for (const auto& file : files)
+        watchedFiles.insert (file.getFullPathName().toStdString());
+}
+
+
+
+
+//==============================================================================
+/**
+ Return the value of an argument giving a byte count or number of elements.
+ Doubles are accepted as well as ints, since the sizes of large files do not
+ fit in an int.
+ */
+static int64 extentOf (const Object& value, const std::string& name)
+{
+    switch (value.type())
+    {
+        case 'i': return value.get<int>();
+        case 'd': return int64 (value.get<double>());
+        default: throw std::runtime_error ("wrong data type (" + std::string (1, value.type()) + ") for " + name);
+    }
+}
+
+static int64 check_extent (const Object::Dict& kwar, const std::string& key, int64 defaultValue)
+{
+    auto item = kwar.find (key);
+    return item == kwar.end() ? defaultValue : extentOf (item->second, "keyword " + key);
+}
+
+/**
+ Return an array of count elements of the given type, spaced stride bytes
+ apart, starting at the given location in a file's data. Contiguous native
+ doubles are referenced in place; anything else is converted when the array
+ is first accessed. If the data must be copied, the values are converted at
+ once, and the array does not keep the data alive.
+ */
+static Object mappedArray (const Loaders::FileData& bytes,
+                           const char* start,
+                           std::size_t stride,
+                           std::size_t count,
+                           ElementType type)
+{
+    auto owner = bytes.owner;
+
+    if (! bytes.mustCopy
+        && type.isNativeDouble()
+        && stride == sizeof (double)
+        && reinterpret_cast<uintptr_t> (start) % alignof (double) == 0)
+    {
+        return Object::data (std::make_shared<ArrayDouble1> (owner, reinterpret_cast<const double*> (start), count));
+    }
+
+    auto convert = [owner, start, stride, count, type]
+    {
+        auto array = nd::ndarray<double, 1> (int (count));
+
+        if (count > 0)
+            type.convert (start, stride, &array(0), count);
+
+        return array;
+    };
+    if (bytes.mustCopy)
+    {
+        return Object::data (std::make_shared<ArrayDouble1> (convert()));
+    }
+    return Object::data (std::make_shared<ArrayDouble1> (count, convert));
+}
+
+
+/**
+ Return true if the precision keyword asks for single-precision arrays.
+ */
+static bool check_precision (const Object::Dict& kwar)
+{
+    auto precision = Builtin::check_kwarg<std::string> (kwar, "precision", "f64");
+
+    if (precision != "f64" && precision != "f32")
+    {
+        throw std::runtime_error ("precision must be f64 or f32");
+    }
+    return precision == "f32";
+}
+
+static std::shared_ptr<ArrayFloat1> toSinglePrecision (std::shared_ptr<ArrayDouble1> array)
+{
+    auto convert = [array]
+    {
+        auto data = array->data();
+        return std::vector<float> (data, data + array->size());
+    };
+
+    if (array->isDeferred())
+    {
+        return std::make_shared<ArrayFloat1> (array->size(), convert);
+    }
+    return std::make_shared<ArrayFloat1> (convert());
+}
+
+/**
+ Convert the double arrays in a loaded object, which is an array or a dict or
+ list of them, to single precision. Arrays that have not been read yet are
+ converted when they are first accessed, so that at most one column at a time
+ is held in double precision.
+ */
+static Object toSinglePrecision (const Object& loaded)
+{
+    switch (loaded.type())
+    {
+        case 'D':
+        {
+            auto result = Object::Dict();
+
+            for (const auto& item : loaded.get<Object::Dict>())
+                result[item.first] = toSinglePrecision (item.second);
+
+            return result;
+        }
+        case 'L':
+        {
+            auto result = Object::List();
+
+            for (const auto& item : loaded.get<Object::List>())
+                result.push_back (toSinglePrecision (item));
+
+            return result;
+        }
+        case 'U':
+        {
+            if (auto array = std::dynamic_pointer_cast<ArrayDouble1> (loaded.get<Object::Data>().v))
+                return Object::data (toSinglePrecision (array));
+
+            return loaded;
+        }
+        default: return loaded;
+    }
+}
+
+
+
+//==============================================================================
+/**
+ Return the subset of rows selected by the every, rows and sample keywords of
+ load-txt. The rows keyword is a (first last) list giving the half-open range
+ of data rows to read.
+ */
+static AsciiIndex::Selection check_selection (const Object::Dict& kwar)
+{
+    auto selection = AsciiIndex::Selection();
+    auto every = check_extent (kwar, "every", 1);
+    auto sample = check_extent (kwar, "sample", 0);
+
+    if (kwar.count ("rows"))
+    {
+        if (kwar.at ("rows").type() != 'L' || kwar.at ("rows").get<Object::List>().size() != 2)
+        {
+            throw std::runtime_error ("rows must be a (first last) list");
+        }
+        auto first = extentOf (kwar.at ("rows")[std::size_t (0)], "rows");
+        auto last = extentOf (kwar.at ("rows")[std::size_t (1)], "rows");
+
+        if (first < 0 || last < first)
+        {
+            throw std::runtime_error ("rows must be a (first last) list with 0 <= first <= last");
+        }
+        selection.first = (unsigned long) first;
+        selection.last = (unsigned long) last;
+    }
+    if (every < 1 || sample < 0)
+    {
+        throw std::runtime_error ("every must be positive and sample must not be negative");
+    }
+    selection.every = (unsigned long) every;
+    selection.sample = (unsigned long) sample;
+    selection.seed = (unsigned long) Builtin::check_kwarg<int> (kwar, "seed", 0);
+    return selection;
+}
+
+/**
+ Index the selected rows of a text file, and return its columns deferred, so
+ that each is tokenized when it is first accessed. The columns share the index
+ and the file's bytes, which are released when the last of them is.
+ */
+static Object::Dict indexColumns (const Loaders::FileData& source, AsciiIndex::Selection selection)
+{
+    auto index = std::make_shared<AsciiIndex> (source.data, source.data + source.size, selection);
+    auto columns = Object::Dict();
+
+    if (! index->getStatusMessage().empty())
+    {
+        throw std::runtime_error (index->getStatusMessage());
+    }
+    for (int n = 0; n < index->getNumColumns(); ++n)
+    {
+        auto owner = source.owner;
+        auto parse = [owner, index, n] { return index->parseColumn (n); };
+        columns[index->getColumnName(n)] = Object::data (std::make_shared<ArrayDouble1> (index->getNumRows(), parse));
+    }
+    return columns;
+}
+
+Object Loaders::load_txt (const Object::List& args, const Object::Dict& kwar)
+{
+    auto fname = Builtin::check<std::string> (args, 0);
+    auto followFile = Builtin::check_kwarg<int> (kwar, "follow", 0);
+    auto useCache = Builtin::check_kwarg<int> (kwar, "cache", 0);
+    auto lazy = Builtin::check_kwarg<int> (kwar, "lazy", 1);
+    auto singlePrecision = check_precision (kwar);
+    auto selection = check_selection (kwar);
+    auto file = File::getCurrentWorkingDirectory().getChildFile (fname);
+
+    if (! file.existsAsFile())
+    {
+        throw std::runtime_error ("file not found: " + fname);
+    }
+    auto staged = takeStagedColumns (file);
+
+    if (kwar.empty() && ! staged.empty())
+    {
+        return staged;
+    }
+
+    /*
+     The file is memory-mapped rather than read into a string, so the only
+     heap allocation is the column data itself. When following a file only
+     the appended bytes are parsed, and the mapping is released before
+     returning.
+     */
+    auto source = mapFile (file);
+    auto begin = source.data;
+    auto end = begin + source.size;
+
+    if (! selection.isEverything() && (followFile || useCache || isGzipped (begin, end)))
+    {
+        throw std::runtime_error ("every, rows and sample cannot be used with follow, cache, or compressed files");
+    }
+    if (followFile && singlePrecision)
+    {
+        throw std::runtime_error ("precision=f32 cannot be used with follow");
+    }
+    auto columns = Object::Dict();
+
+    if (followFile)
+    {
+        if (isGzipped (begin, end))
+        {
+            throw std::runtime_error ("follow is not supported for compressed files");
+        }
+        return follow (file.getFullPathName().toStdString(), begin, end);
+    }
+    auto version = ColumnCache::SourceVersion();
+
+    if (useCache)
+    {
+        version = getSourceVersion (file, begin, end);
+
+        if (ColumnCache::read (file, version, columns))
+        {
+            return singlePrecision ? toSinglePrecision (columns) : columns;
+        }
+    }
+
+    /*
+     Unless the columns are to be cached, the rows are only indexed here, and
+     each column is tokenized when it is first accessed. The columns share the
+     index and the mapping of the file, which are released when the last of
+     them is. Since a watched file must not stay mapped, its text is read into
+     memory for lazy columns (see readFile); a selection of its rows is
+     parsed eagerly below instead, as it is only a part of the file.
+     */
+    if (lazy && ! useCache && ! isGzipped (begin, end) && (! source.mustCopy || selection.isEverything()))
+    {
+        columns = indexColumns (source.mustCopy ? readFile (file) : source, selection);
+        return singlePrecision ? toSinglePrecision (columns) : columns;
+    }
+    auto names = std::vector<std::string>();
+    auto arrays = std::vector<std::shared_ptr<ArrayDouble1>>();
+
+    if (isGzipped (begin, end))
+    {
+        loadGzipped (file, names, arrays);
+    }
+    else if (! selection.isEverything())
+    {
+        AsciiIndex index (begin, end, selection);
+        auto targets = std::vector<double*>();
+        names = index.getColumnNames();
+
+        if (! index.getStatusMessage().empty())
+        {
+            throw std::runtime_error (index.getStatusMessage());
+        }
+
+        for (int n = 0; n < index.getNumColumns(); ++n)
+        {
+            arrays.push_back (std::make_shared<ArrayDouble1> (nd::ndarray<double, 1> (int (index.getNumRows()))));
+            targets.push_back (arrays.back()->size() > 0 ? &arrays.back()->get()(0) : nullptr);
+        }
+        auto status = index.parseRows (targets);
+
+        if (! status.empty())
+        {
+            throw std::runtime_error (status);
+        }
+    }
+    else
+    {
+        AsciiLoader loader (begin, end);
+
+        if (! loader.getStatusMessage().empty())
+        {
+            throw std::runtime_error (loader.getStatusMessage());
+        }
+        names = loader.getColumnNames();
+
+        for (int n = 0; n < loader.getNumColumns(); ++n)
+        {
+            arrays.push_back (std::make_shared<ArrayDouble1> (loader.takeColumnData (n)));
+        }
+    }
+
+    for (int n = 0; n < names.size(); ++n)
+    {
+        columns[names[n]] = Object::data (arrays[n]);
+    }
+
+    if (useCache)
+    {
+        ColumnCache::write (file, version, names, arrays);
+    }
+    return singlePrecision ? toSinglePrecision (columns) : columns;
+}
+
+Object Loaders::load_glob (const Object::List& args, const Object::Dict& kwar)
+{
+    auto pattern = Builtin::check<std::string> (args, 0);
+    auto singlePrecision = check_precision (kwar);
+    auto slash = pattern.find_last_of ('/');
+    auto directory = File::getCurrentWorkingDirectory().getChildFile (slash == std::string::npos ? "." : pattern.substr (0, slash));
+    auto wildcard = slash == std::string::npos ? pattern : pattern.substr (slash + 1);
+    auto files = Array<File>();
+    directory.findChildFiles (files, File::findFiles, false, wildcard);
+
+    if (files.isEmpty())
+    {
+        throw std::runtime_error ("no files match " + pattern);
+    }
+    std::sort (files.begin(), files.end(), [] (const File& a, const File& b)
+    {
+        return a.getFileName().compareNatural (b.getFileName()) < 0;
+    });
+
+    /*
+     The files are indexed in parallel, which gives the number of rows in each.
+     The concatenated columns are then allocated at their final size, and the
+     files are parsed in parallel, each directly into its own range of rows.
+     */
+    auto sources = std::vector<std::unique_ptr<MemoryMappedFile>> (files.size());
+    auto indexes = std::vector<std::unique_ptr<AsciiIndex>> (files.size());
+
+    Parallel::forEach (files.size(), [&] (std::size_t n)
+    {
+        sources[n] = std::make_unique<MemoryMappedFile> (files[n], MemoryMappedFile::readOnly);
+        auto begin = static_cast<const char*> (sources[n]->getData());
+        auto end = begin + (begin ? sources[n]->getSize() : 0);
+        indexes[n] = std::make_unique<AsciiIndex> (begin, end);
+    });
+
+    const auto& names = indexes.front()->getColumnNames();
+    auto firstRows = std::vector<unsigned long> (1, 0);
+
+    for (int n = 0; n < files.size(); ++n)
+    {
+        if (! indexes[n]->getStatusMessage().empty())
+        {
+            throw std::runtime_error (indexes[n]->getStatusMessage() + " of " + files[n].getFileName().toStdString());
+        }
+        if (indexes[n]->getColumnNames() != names)
+        {
+            throw std::runtime_error (files[n].getFileName().toStdString() + " has different columns from "
+                                      + files[0].getFileName().toStdString());
+        }
+        firstRows.push_back (firstRows.back() + indexes[n]->getNumRows());
+    }
+
+    auto columns = std::vector<nd::ndarray<double, 1>>();
+
+    for (int j = 0; j < names.size(); ++j)
+    {
+        columns.emplace_back (int (firstRows.back()));
+    }
+
+    Parallel::forEach (files.size(), [&] (std::size_t n)
+    {
+        if (indexes[n]->getNumRows() == 0)
+            return;
+
+        auto targets = std::vector<double*>();
+
+        for (auto& column : columns)
+            targets.push_back (&column (int (firstRows[n])));
+
+        auto status = indexes[n]->parseRows (targets);
+
+        if (! status.empty())
+            throw std::runtime_error (status + " of " + files[n].getFileName().toStdString());
+    });
+
+    auto result = Object::Dict();
+
+    for (int j = 0; j < names.size(); ++j)
+    {
+        auto column = std::make_shared<ArrayDouble1> (std::move (columns[j]));
+        result[names[j]] = singlePrecision ? Object::data (toSinglePrecision (column)) : Object::data (column);
+    }
+    return result;
+}
+
+Object Loaders::load_csv (const Object::List& args, const Object::Dict& kwar)
 {
     auto fname = Builtin::check<std::string> (args, 0);
+    auto delimiter = Builtin::check_kwarg<std::string> (kwar, "delimiter", "");
+    auto quote = Builtin::check_kwarg<std::string> (kwar, "quote", "\"");
+    auto file = File::getCurrentWorkingDirectory().getChildFile (fname);
+    auto options = CsvLoader::Options();
+
+    if (delimiter == "tab")
+    {
+        delimiter = "\t";
+    }
+    if (delimiter.size() > 1 || quote.size() != 1)
+    {
+        throw std::runtime_error ("delimiter and quote must be single characters");
+    }
+    if (! file.existsAsFile())
+    {
+        throw std::runtime_error ("file not found: " + fname);
+    }
+    options.delimiter = delimiter.empty() ? 0 : delimiter[0];
+    options.quote = quote[0];
+    options.header = Builtin::check_kwarg<int> (kwar, "header", -1);
+    auto singlePrecision = check_precision (kwar);
 
-    std::fstream input (fname);
-    AsciiLoader loader (input);
+    MemoryMappedFile source (file, MemoryMappedFile::readOnly);
+    auto begin = static_cast<const char*> (source.getData());
+    auto end = begin + (begin ? source.getSize() : 0);
+    auto loader = CsvLoader (begin, end, options);
 
     if (! loader.getStatusMessage().empty())
     {
         throw std::runtime_error (loader.getStatusMessage());
     }
-    auto columns = Object::dict();
+    auto columns = Object::Dict();
 
     for (int n = 0; n < loader.getNumColumns(); ++n)
     {
-        auto user = std::make_shared<ArrayDouble1> (loader.getColumnData(n));
-        columns[loader.getColumnName(n)] = Object::data (user);
+        auto column = Object::data (loader.takeColumnData (n));
+        columns[loader.getColumnName (n)] = singlePrecision ? toSinglePrecision (column) : column;
     }
     return columns;
 }
 
+Object Loaders::load_npy (const Object::List& args, const Object::Dict& kwar)
+{
+    auto fname = Builtin::check<std::string> (args, 0);
+    auto singlePrecision = check_precision (kwar);
+    auto file = File::getCurrentWorkingDirectory().getChildFile (fname);
+
+    if (! file.existsAsFile())
+    {
+        throw std::runtime_error ("file not found: " + fname);
+    }
+    auto array = NpyFile::load (file);
+    return singlePrecision ? toSinglePrecision (array) : array;
+}
+
+Object Loaders::load_fits (const Object::List& args, const Object::Dict& kwar)
+{
+    auto fname = Builtin::check<std::string> (args, 0);
+    auto hdu = Builtin::check_kwarg<int> (kwar, "hdu", -1);
+    auto singlePrecision = check_precision (kwar);
+    auto file = File::getCurrentWorkingDirectory().getChildFile (fname);
+
+    if (! file.existsAsFile())
+    {
+        throw std::runtime_error ("file not found: " + fname);
+    }
+    auto loaded = FitsFile::load (file, hdu);
+    return singlePrecision ? toSinglePrecision (loaded) : loaded;
+}
+
+Object Loaders::save_npy (const Object::List& args, const Object::Dict&)
+{
+    auto fname = Builtin::check<std::string> (args, 0);
+    auto file = File::getCurrentWorkingDirectory().getChildFile (fname);
+
+    if (args.size() > 1 && args[1].type() == 'U')
+    {
+        if (auto array = dynamic_cast<ArrayDoubleN*> (args[1].get<Object::Data>().v.get()))
+        {
+            NpyFile::save (file, *array);
+            return file.getFullPathName().toStdString();
+        }
+    }
+    NpyFile::save (file, Builtin::check_user_data<ArrayDouble1> (args, 1));
+    return file.getFullPathName().toStdString();
+}
+
+Object Loaders::load_bin (const Object::List& args, const Object::Dict& kwar)
+{
+    auto fname = Builtin::check<std::string> (args, 0);
+    auto dtype = Builtin::check_kwarg<std::string> (kwar, "dtype", "f64");
+    auto endian = Builtin::check_kwarg<std::string> (kwar, "endian", "native");
+    auto order = Builtin::check_kwarg<std::string> (kwar, "order", "C");
+    auto offset = check_extent (kwar, "offset", 0);
+    auto singlePrecision = check_precision (kwar);
+    auto type = ElementType::fromName (dtype, endian);
+    auto file = File::getCurrentWorkingDirectory().getChildFile (fname);
+
+    if (! file.existsAsFile())
+    {
+        throw std::runtime_error ("file not found: " + fname);
+    }
+    if (order != "C" && order != "F")
+    {
+        throw std::runtime_error ("order must be C or F");
+    }
+
+    auto bytes = mapFile (file);
+    auto data = bytes.data;
+    auto size = bytes.size;
+
+    if (offset < 0 || offset > size)
+    {
+        throw std::runtime_error ("offset is outside the file");
+    }
+
+    /*
+     The shape is either a number of elements, or a (rows columns) list, in
+     which case a list of the columns is returned. If it is omitted, the array
+     extends to the end of the file. The stride is the number of bytes between
+     consecutive elements of a 1-d array, or between the rows of a 2-d one.
+     */
+    auto shape = std::vector<int64>();
+
+    if (kwar.count ("shape") && kwar.at ("shape").type() == 'L')
+    {
+        for (const auto& extent : kwar.at ("shape").get<Object::List>())
+        {
+            shape.push_back (extentOf (extent, "shape"));
+        }
+    }
+    else
+    {
+        shape.push_back (check_extent (kwar, "shape", -1));
+    }
+
+    if (shape.empty() || shape.size() > 2 || (shape.size() == 2 && (shape[0] < 0 || shape[1] < 0)))
+    {
+        throw std::runtime_error ("shape must be a number of elements or a (rows columns) list");
+    }
+
+    auto numColumns = shape.size() == 2 ? shape[1] : 1;
+    auto defaultStride = order == "C" ? numColumns * type.size : int64 (type.size);
+    auto stride = check_extent (kwar, "stride", defaultStride);
+    auto numRows = shape[0] >= 0 ? shape[0] : (size - offset >= type.size && stride > 0 ? (size - offset - type.size) / stride + 1 : 0);
+    auto columnStep = order == "C" ? int64 (type.size) : numRows * stride;
+
+    if (stride < type.size)
+    {
+        throw std::runtime_error ("stride must be at least the element size");
+    }
+    if (numRows > 0 && numColumns > 0 && offset + (numRows - 1) * stride + (numColumns - 1) * columnStep + type.size > size)
+    {
+        throw std::runtime_error ("shape extends past the end of the file");
+    }
+
+    if (shape.size() == 1)
+    {
+        auto array = mappedArray (bytes, data + offset, stride, numRows, type);
+        return singlePrecision ? toSinglePrecision (array) : array;
+    }
+    auto columns = Object::List();
+
+    for (int64 j = 0; j < numColumns; ++j)
+    {
+        columns.push_back (mappedArray (bytes, data + offset + j * columnStep, stride, numRows, type));
+    }
+    return singlePrecision ? toSinglePrecision (columns) : columns;
+}
+
+void Loaders::loadInBackground (const std::string& filename, Progress& progress)
+{
+    auto file = File (filename);
+    auto size = file.getSize();
+    auto modified = file.getLastModificationTime().toMilliseconds();
+    auto names = std::vector<std::string>();
+    auto arrays = std::vector<std::shared_ptr<ArrayDouble1>>();
+    auto columns = Object::dict();
+
+    if (! file.existsAsFile())
+    {
+        throw std::runtime_error ("could not read " + filename);
+    }
+    progress.bytesTotal = size;
+    auto source = mapFile (file);
+
+    if (isGzipped (source.data, source.data + source.size))
+    {
+        source = FileData();
+        loadGzipped (file, names, arrays, &progress);
+    }
+    else
+    {
+        /*
+         The mapped text is handed to the parser a chunk at a time, as the
+         decompressed text of a gzip file is, so that the load reports its
+         progress and can be cancelled while the rows are tokenized. Only a
+         chunk of the text is copied at once, and the mapping is released
+         when the load returns.
+         */
+        const int64 chunkSize = 1 << 20;
+        auto position = int64 (0);
+
+        auto nextChunk = [&source, &position, &progress, chunkSize] (std::string& chunk)
+        {
+            auto numBytes = std::min (chunkSize, source.size - position);
+            chunk.assign (source.data + position, std::size_t (numBytes));
+            position += numBytes;
+            progress.bytesProcessed = position;
+            return position < source.size;
+        };
+        parseChunks (nextChunk, names, arrays, &progress);
+    }
+
+    for (int n = 0; n < names.size(); ++n)
+    {
+        columns.get<Object::Dict>()[names[n]] = Object::data (arrays[n]);
+    }
+    columns = Database::getInstance().store (columns);
+
+    std::lock_guard<std::mutex> lock (stagedFilesMutex);
+    auto& staged = stagedFiles[file.getFullPathName().toStdString()];
+    staged.size = size;
+    staged.modified = modified;
+    staged.columns = columns;
+}
+
+void Loaders::release (const std::string& filename)
+{
+    followedFiles.erase (filename);
+
+    std::lock_guard<std::mutex> lock (stagedFilesMutex);
+    stagedFiles.erase (File (filename).getFullPathName().toStdString());
+}
+
 
 
 
 //==============================================================================
+/**
+ Return a loader that registers the columns it returns with the database, so
+ that they are deduplicated against the columns already in memory.
+ */
+static std::function<Object (const Object::List&, const Object::Dict&)> stored (std::function<Object (const Object::List&, const Object::Dict&)> loader)
+{
+    return [loader] (const Object::List& args, const Object::Dict& kwar)
+    {
+        return Database::getInstance().store (loader (args, kwar));
+    };
+}
+
 Object::Dict Loaders::loaders()
 {
 	auto m = Object::Dict();
-    m["load-txt"] = Object::Func (load_txt);
+    m["load-txt"] = Object::Func (stored (load_txt), "(load-txt filename:{string} follow={int} cache={int} lazy={int} every={int} rows={list} sample={int} seed={int} precision={string})");
+    m["load-csv"] = Object::Func (stored (load_csv), "(load-csv filename:{string} delimiter={string} quote={string} header={int} precision={string})");
+    m["load-glob"] = Object::Func (stored (load_glob), "(load-glob pattern:{string} precision={string})");
+    m["load-npy"] = Object::Func (stored (load_npy), "(load-npy filename:{string} precision={string})");
+    m["load-bin"] = Object::Func (stored (load_bin), "(load-bin filename:{string} dtype={string} endian={string} shape={int|list} offset={int} stride={int} order={string} precision={string})");
+    m["load-fits"] = Object::Func (stored (load_fits), "(load-fits filename:{string} hdu={int} precision={string})");
+    m["save-npy"] = Object::Func (save_npy, "(save-npy filename:{string} array:{ArrayDouble1|ArrayDoubleN})");
 	return m;
 }
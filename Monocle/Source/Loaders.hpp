@@ -1,4 +1,6 @@
 #pragma once
+#include <atomic>
+#include "JuceHeader.h"
 #include "Kernel/Object.hpp"
 
 
@@ -10,6 +12,107 @@ class Loaders
 public:
     using Object = mcl::Object;
 
+    /** The state of a load running on a background thread, shared with the
+        thread that started it.
+     */
+    struct Progress
+    {
+        std::atomic<long long> bytesProcessed { 0 };
+        std::atomic<long long> bytesTotal { 0 };
+        std::atomic<bool> cancelled { false };
+    };
+
+    /** The bytes of a file, which remain valid for as long as owner is alive.
+        mustCopy is set if the bytes are a mapping of a watched file, which
+        arrays must not keep referring to.
+     */
+    struct FileData
+    {
+        std::shared_ptr<const void> owner;
+        const char* data = nullptr;
+        int64 size = 0;
+        bool mustCopy = false;
+    };
+
+    /** Memory-map a file. The values of a watched file are to be converted
+        into arrays of their own before the mapping is released, rather than
+        referenced.
+     */
+    static FileData mapFile (const File& file);
+
+    /** Return the bytes of a file for arrays that keep referring to them, such
+        as lazily parsed text columns. The file is memory-mapped, unless it is
+        one of the watched files, in which case it is read into memory.
+     */
+    static FileData readFile (const File& file);
+
+    /** Set the files that the application watches for changes. Such files
+        may be truncated and rewritten in place, as numpy.save and most
+        simulation codes do, and an array referencing a mapping of a file
+        faults (SIGBUS) on its next access once the file has been truncated.
+        Loaders therefore only reference the mappings of files that are not
+        watched.
+     */
+    static void setWatchedFiles (const Array<File>& files);
+
+    /** Return the loader functions. Each loader accepts precision=f32 to
+        return its numeric columns as ArrayFloat1 rather than ArrayDouble1.
+        The columns they return are registered with the Database.
+     */
     static Object::Dict loaders();
     static Object load_txt (const Object::List& args, const Object::Dict&);
+
+    /** Load a delimited text file with typed columns. The delimiter is
+        detected unless given ('tab' may be used for a tab), and header is 1,
+        0, or -1 to detect whether the first row names the columns.
+     */
+    static Object load_csv (const Object::List& args, const Object::Dict&);
+
+    /** Load every text file matching a wildcard pattern, such as
+        "output/run_*.txt", and return their columns concatenated in the
+        natural order of the file names. The files are parsed in parallel, and
+        must all have the same columns.
+     */
+    static Object load_glob (const Object::List& args, const Object::Dict&);
+
+    /** Load a .npy file. An array of more than one dimension is returned as an
+        ArrayDoubleN over the file's payload, and is kept in double precision
+        whatever the precision keyword.
+     */
+    static Object load_npy (const Object::List& args, const Object::Dict&);
+
+    /** Load a raw binary array. The element type, byte order, shape, byte
+        offset and stride are given by keyword arguments; the data is mapped,
+        and converted to double on first access if necessary, or at once if
+        the file is watched.
+     */
+    static Object load_bin (const Object::List& args, const Object::Dict&);
+
+    /** Load an image or binary table from a FITS file. The hdu keyword selects
+        the header and data unit; by default the first one with data is read.
+     */
+    static Object load_fits (const Object::List& args, const Object::Dict&);
+
+    /** Write an array to a .npy file, and return the full path of the file. */
+    static Object save_npy (const Object::List& args, const Object::Dict&);
+
+    /** Parse a text file, which may be gzip-compressed, in chunks, updating
+        the progress as each is parsed. An uncompressed file is memory-mapped,
+        and a compressed one parsed as it is decompressed, so neither is held
+        in memory as a whole; the columns are parsed here, so that the thread
+        using them does not have to. They are staged, so that the next
+        load-txt of the file with no keywords returns them rather than reading
+        it again, as long as the file has not changed since. Any other load-txt
+        of the file discards them. If the progress is cancelled, an exception
+        is thrown as soon as the current chunk is parsed, and the rows parsed
+        so far are freed. This is meant to be called on a background thread;
+        the filename must be a full path.
+     */
+    static void loadInBackground (const std::string& filename, Progress& progress);
+
+    /** Discard the state kept for the given file by incremental loading, if
+        it was loaded with follow=1, and by background loading. This is called
+        when the file is removed, or a symbol loading it is redefined.
+     */
+    static void release (const std::string& filename);
 };
@@ -4,6 +4,7 @@
 #include "Kernel/Expression.hpp"
 #include "Loaders.hpp"
 #include "NumericData.hpp"
+#include "Numerical/VectorMath.hpp"
 
 
 
@@ -205,6 +206,7 @@ MainComponent::MainComponent()
     symbolListAndDetail.setContent2 (symbolDetails);
 
     fileManager.setPollingInterval (100);
+    fileManager.setContentVerification (true);
     figure     .setModel (model = FigureModel::createExample());
 
     definitionEditor.setValidator ([this] (const auto& key, const auto& expr) -> std::string
@@ -224,6 +226,7 @@ MainComponent::MainComponent()
     });
 
     fileManager     .addListener (this);
+    loadQueue       .addListener (this);
     fileList        .addListener (this);
     symbolList      .addListener (this);
     symbolDetails   .addListener (this);
@@ -235,6 +238,9 @@ MainComponent::MainComponent()
     setSize (800, 600);
 
     mcl::Expression::testParser();
+    mcl::AcyclicGraph::testIncrementalUpdates();
+    mcl::Builtin::testArrayOperations();
+    VectorMath::testAccuracy();
 
     // Initial kernel configuration
     // ========================================================================
@@ -259,7 +265,12 @@ MainComponent::MainComponent()
 
     kernel.setErrorLog ([this] (const std::string& key, const std::string& msg) { DBG("error: " << key << " " << msg); });
     kernel.import (mcl::Builtin::builtin());
+    kernel.import (mcl::Builtin::arithmetic());
+    kernel.import (mcl::Builtin::trigonometric());
+    kernel.import (mcl::Builtin::array());
+    kernel.import (mcl::Builtin::query());
     kernel.import (Loaders::loaders());
+    kernel.import (Database::database());
     kernel.import (PlotModels::plot_models());
 
     kernel.insert ("L", mcl::Object::Expr ("(line-plot x y)"));
@@ -350,7 +361,82 @@ void MainComponent::fileManagerFileChangedOnDisk (File file)
 {
     fileList.updateFileDisplayStatus (file);
     fileDetails.updateFileDetailsIfShowing (file);
-    kernel.touch (File (file).getFileNameWithoutExtension().toStdString());
+    auto key = fileManager.getUniqueKey (file.getFullPathName());
+
+    /*
+     A file that was rewritten, and whose data symbol loads it as the filter
+     does, is reloaded in the background, and its dependents are updated when
+     that has finished. Appended rows, and data loaded any other way, are read
+     in place.
+     */
+    if (! fileManager.wasAppendedTo (file) && hasDefaultDataSymbol (key))
+    {
+        loadQueue.startLoading (file);
+        return;
+    }
+    auto change = fileManager.wasAppendedTo (file)
+    ? mcl::AcyclicGraph::Change::appended
+    : mcl::AcyclicGraph::Change::replaced;
+
+    kernel.touch (key, change);
+}
+
+//==========================================================================
+void MainComponent::loadQueueProgressChanged (File file, double fraction, double secondsRemaining)
+{
+    fileList.setFileLoadProgress (file, fraction);
+    fileDetails.setFileLoadProgress (file, fraction, secondsRemaining);
+}
+
+void MainComponent::loadQueueFileLoaded (File file, const String& error)
+{
+    auto fileKey = fileManager.getUniqueKey (file.getFullPathName());
+    auto newSymbol = fileKey + "-data";
+
+    fileList.setFileLoadError (file, error);
+    fileDetails.setFileLoadError (file, error);
+
+    /*
+     A data symbol that already exists is updated even if the reload failed,
+     since the file has changed, and it then shows the error from load-txt.
+     */
+    if (kernel.contains (newSymbol))
+    {
+        kernel.touch (fileKey);
+    }
+    else if (error.isEmpty())
+    {
+        kernel.insert (newSymbol, mcl::Object::expr ("(load-txt " + fileKey + ")"));
+        symbolList.addKeyToSelection (newSymbol);
+    }
+}
+
+/**
+ Return true if the data symbol of the given file still has the definition the
+ filter gave it, so that a background load of the file yields its value.
+ */
+bool MainComponent::hasDefaultDataSymbol (const std::string& fileKey) const
+{
+    return kernel.abstract (fileKey + "-data").expression() == "(load-txt " + fileKey + ")";
+}
+
+/**
+ Cancel the background load of the file whose symbol, or whose data symbol,
+ has the given key, and discard the columns staged for it, because the symbol
+ is being removed or redefined.
+ */
+void MainComponent::cancelLoadingForSymbol (const std::string& key)
+{
+    for (const auto& file : fileManager.getFiles())
+    {
+        auto fileKey = fileManager.getUniqueKey (file.getFullPathName());
+
+        if (key == fileKey || key == fileKey + "-data")
+        {
+            loadQueue.cancelLoading (file);
+            Loaders::release (file.getFullPathName().toStdString());
+        }
+    }
 }
 
 //==========================================================================
@@ -358,6 +444,7 @@ void MainComponent::fileListFilesInserted (const StringArray& files, int index)
 {
     fileManager.insertFiles (files, index);
     fileList.setFileList (fileManager.getFiles());
+    Loaders::setWatchedFiles (fileManager.getFiles());
 
     for (const auto& file : files)
     {
@@ -371,10 +458,13 @@ void MainComponent::fileListFilesRemoved (const StringArray& files)
 {
     for (const auto& file : files)
     {
+        loadQueue.cancelLoading (File (file));
         kernel.remove (fileManager.getUniqueKey (file));
+        Loaders::release (file.toStdString());
     }
     fileManager.removeFiles (files);
     fileList.setFileList (fileManager.getFiles());
+    Loaders::setWatchedFiles (fileManager.getFiles());
 }
 
 void MainComponent::fileListSelectionChanged (const StringArray& files)
@@ -389,12 +479,13 @@ void MainComponent::fileListWantsToApplyFilter (const StringArray& files, const
         skeleton.openNavSection ("Symbols");
         symbolList.deselectAllRows();
     }
+    /*
+     The files are read in the background, and the symbols for their data
+     are inserted as each finishes loading.
+     */
     for (const auto& file : files)
     {
-        auto fileKey = fileManager.getUniqueKey (file);
-        auto newSymbol = fileKey + "-data";
-        kernel.insert (newSymbol, mcl::Object::expr ("(load-txt " + fileKey + ")"));
-        symbolList.addKeyToSelection (newSymbol);
+        loadQueue.startLoading (File (file));
     }
 }
 
@@ -410,7 +501,10 @@ void MainComponent::symbolListSelectionChanged (const StringArray& symbols)
 void MainComponent::symbolListSymbolsRemoved (const StringArray& symbols)
 {
     for (const auto& key : symbols)
+    {
+        cancelLoadingForSymbol (key.toStdString());
         kernel.remove (key.toStdString());
+    }
 }
 
 void MainComponent::symbolListSymbolPunched (const String& symbol)
@@ -435,6 +529,7 @@ void MainComponent::symbolDetailsItemPunched (const std::string& expression)
 
 void MainComponent::symbolDetailsWantsNewDefinition (const std::string& key, const std::string& expression)
 {
+    cancelLoadingForSymbol (key);
     kernel.insert (key, mcl::Object::expr (expression));
     symbolList.selectOnlyKeys ({key});
 }
@@ -442,6 +537,7 @@ void MainComponent::symbolDetailsWantsNewDefinition (const std::string& key, con
 //==========================================================================
 void MainComponent::definitionEditorCommited (const std::string& key, const std::string& expression)
 {
+    cancelLoadingForSymbol (key);
     kernel.insert (key, mcl::Object::expr (expression));
     skeleton.setBackdropRevealed (false);
     symbolList.grabKeyboardFocus();
@@ -4,6 +4,7 @@
 #include "FigureView.hpp"
 #include "AppSkeleton.hpp"
 #include "FileManager.hpp"
+#include "LoadQueue.hpp"
 #include "Database.hpp"
 #include "FileListView.hpp"
 #include "FileDetailsView.hpp"
@@ -81,6 +82,7 @@ class MainComponent
 , public ApplicationCommandTarget
 , public FileDragAndDropTarget
 , private FileManager::Listener
+, private LoadQueue::Listener
 , private FileListView::Listener
 , private SymbolListView::Listener
 , private SymbolDetailsView::Listener
@@ -112,6 +114,12 @@ private:
     //==========================================================================
     void fileManagerFileChangedOnDisk (File) override;
 
+    //==========================================================================
+    void loadQueueProgressChanged (File file, double fraction, double secondsRemaining) override;
+    void loadQueueFileLoaded (File file, const String& error) override;
+    void cancelLoadingForSymbol (const std::string& key);
+    bool hasDefaultDataSymbol (const std::string& fileKey) const;
+
     //==========================================================================
     void fileListFilesInserted (const StringArray& files, int index) override;
     void fileListFilesRemoved (const StringArray& files) override;
@@ -153,6 +161,7 @@ private:
 
     //==========================================================================
     FileManager fileManager;
+    LoadQueue loadQueue;
     FigureModel model;
     mcl::AcyclicGraph kernel;
 };
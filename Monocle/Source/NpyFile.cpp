@@ -0,0 +1,213 @@
+#include "NpyFile.hpp"
+#include "ElementType.hpp"
+#include "Loaders.hpp"
+#define NPY_MAGIC "\x93NUMPY"
+using namespace mcl;
+
+
+
+
+// ============================================================================
+static const char* findValueOfKey (const std::string& header, const std::string& key)
+{
+    for (auto quote : { "'", "\"" })
+    {
+        auto k = header.find (quote + key + quote);
+
+        if (k != std::string::npos)
+        {
+            auto colon = header.find (':', k);
+
+            if (colon != std::string::npos)
+            {
+                auto c = header.c_str() + colon + 1;
+
+                while (*c == ' ')
+                    ++c;
+                return c;
+            }
+        }
+    }
+    throw std::runtime_error ("npy header is missing the key " + key);
+}
+
+static std::string parseQuotedString (const char* c)
+{
+    if (*c != '\'' && *c != '"')
+        throw std::runtime_error ("npy header has a bad descr");
+
+    auto end = std::strchr (c + 1, *c);
+
+    if (end == nullptr)
+        throw std::runtime_error ("npy header has a bad descr");
+
+    return std::string (c + 1, end);
+}
+
+static std::vector<int64> parseShape (const char* c)
+{
+    if (*c != '(')
+        throw std::runtime_error ("npy header has a bad shape");
+
+    auto shape = std::vector<int64>();
+
+    for (++c; *c != ')'; )
+    {
+        if (*c == '\0')
+            throw std::runtime_error ("npy header has a bad shape");
+
+        if (*c == ' ' || *c == ',')
+        {
+            ++c;
+            continue;
+        }
+        char* parsed = nullptr;
+        auto extent = std::strtoll (c, &parsed, 10);
+
+        if (parsed == c || extent < 0)
+            throw std::runtime_error ("npy header has a bad shape");
+
+        shape.push_back (extent);
+        c = parsed;
+    }
+    return shape;
+}
+
+
+
+
+// ============================================================================
+NpyFile::Header NpyFile::parseHeader (const char* data, int64 size)
+{
+    if (size < 10 || std::memcmp (data, NPY_MAGIC, 6) != 0)
+        throw std::runtime_error ("not an npy file");
+
+    auto major = uint8 (data[6]);
+    auto lengthSize = major == 1 ? 2 : 4;
+    auto preambleSize = 8 + lengthSize;
+
+    if (major < 1 || major > 3 || size < preambleSize)
+        throw std::runtime_error ("unsupported npy version " + std::to_string (major));
+
+    auto length = lengthSize == 2
+    ? int64 (ByteOrder::littleEndianShort (data + 8))
+    : int64 (ByteOrder::littleEndianInt (data + 8));
+
+    if (preambleSize + length > size)
+        throw std::runtime_error ("npy header is truncated");
+
+    auto text = std::string (data + preambleSize, data + preambleSize + length);
+    auto header = Header();
+    header.descr = parseQuotedString (findValueOfKey (text, "descr"));
+    header.fortranOrder = std::strncmp (findValueOfKey (text, "fortran_order"), "True", 4) == 0;
+    header.shape = parseShape (findValueOfKey (text, "shape"));
+    header.dataOffset = preambleSize + length;
+    return header;
+}
+
+Object NpyFile::load (const File& file)
+{
+    auto bytes = Loaders::mapFile (file);
+    auto owner = bytes.owner;
+    auto data = bytes.data;
+    auto size = bytes.size;
+    auto header = parseHeader (data, size);
+    auto type = ElementType::fromNumpyDescr (header.descr);
+
+    auto count = std::size_t (1);
+    auto payload = data + header.dataOffset;
+
+    for (auto extent : header.shape)
+        count *= std::size_t (extent);
+
+    if (int64 (count) > (size - header.dataOffset) / type.size)
+    {
+        throw std::runtime_error ("npy file is truncated");
+    }
+    auto elements = std::shared_ptr<ArrayDouble1>();
+
+    if (! bytes.mustCopy && type.isNativeDouble() && reinterpret_cast<uintptr_t> (payload) % alignof (double) == 0)
+    {
+        elements = std::make_shared<ArrayDouble1> (owner, reinterpret_cast<const double*> (payload), count);
+    }
+    else
+    {
+        auto convert = [owner, payload, count, type]
+        {
+            auto array = nd::ndarray<double, 1> (int (count));
+
+            if (count > 0)
+                type.convert (payload, type.size, &array(0), count);
+
+            return array;
+        };
+        elements = bytes.mustCopy
+            ? std::make_shared<ArrayDouble1> (convert())
+            : std::make_shared<ArrayDouble1> (count, convert);
+    }
+
+    if (header.shape.size() == 1)
+    {
+        return Object::data (elements);
+    }
+    auto shape = std::vector<std::size_t> (header.shape.begin(), header.shape.end());
+    auto order = header.fortranOrder ? ArrayDoubleN::Order::columnMajor : ArrayDoubleN::Order::rowMajor;
+    return Object::data (std::make_shared<ArrayDoubleN> (elements, shape, order));
+}
+
+void NpyFile::save (const File& file, const ArrayDouble1& array)
+{
+    write (file, array.data(), { array.size() }, false);
+}
+
+void NpyFile::save (const File& file, const ArrayDoubleN& array)
+{
+    write (file, array.data(), array.shape(), array.order() == ArrayDoubleN::Order::columnMajor);
+}
+
+void NpyFile::write (const File& file, const double* data, const std::vector<std::size_t>& shape, bool fortranOrder)
+{
+   #if JUCE_LITTLE_ENDIAN
+    auto descr = std::string ("<f8");
+   #else
+    auto descr = std::string (">f8");
+   #endif
+
+    auto count = std::size_t (1);
+    auto extents = std::string();
+
+    for (std::size_t n = 0; n < shape.size(); ++n)
+    {
+        count *= shape[n];
+        extents += (n > 0 ? ", " : "") + std::to_string (shape[n]);
+    }
+
+    if (shape.size() == 1)
+        extents += ",";
+
+    auto text = "{'descr': '" + descr + "', 'fortran_order': " + (fortranOrder ? "True" : "False") + ", 'shape': (" + extents + "), }";
+    auto padding = 63 - (10 + text.size()) % 64;
+    text += std::string (padding, ' ') + '\n';
+
+    TemporaryFile temp (file);
+    {
+        FileOutputStream out (temp.getFile());
+
+        if (out.failedToOpen())
+            throw std::runtime_error ("could not write " + file.getFullPathName().toStdString());
+
+        out.write (NPY_MAGIC, 6);
+        out.writeByte (1);
+        out.writeByte (0);
+        out.writeShort (short (text.size()));
+        out.write (text.data(), text.size());
+        out.write (data, count * sizeof (double));
+        out.flush();
+
+        if (out.getStatus().failed())
+            throw std::runtime_error ("could not write " + file.getFullPathName().toStdString());
+    }
+
+    if (! temp.overwriteTargetFileWithTemporary())
+        throw std::runtime_error ("could not write " + file.getFullPathName().toStdString());
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include "JuceHeader.h"
+#include "NumericData.hpp"
+#include "Kernel/Object.hpp"
+
+
+
+
+// ============================================================================
+/**
+Reader and writer for NumPy's .npy format. Loaded arrays reference the
+memory-mapped payload of the file when it holds native-endian float64 values;
+arrays of other element types are converted to double when first accessed. A
+watched file's values are copied at once (see Loaders::mapFile).
+A 1-d array is loaded as an ArrayDouble1, and any other as an ArrayDoubleN
+over the same elements, in the file's memory order.
+*/
+class NpyFile
+{
+public:
+    struct Header
+    {
+        std::string descr;
+        bool fortranOrder = false;
+        std::vector<int64> shape;
+        int64 dataOffset = 0;
+    };
+
+    /** Parse the header at the start of the given bytes. Throws
+        std::runtime_error if the bytes do not start with a valid header.
+     */
+    static Header parseHeader (const char* data, int64 size);
+
+    /** Load an array from the given file. */
+    static mcl::Object load (const File& file);
+
+    /** Write the given array to a file as float64 values. */
+    static void save (const File& file, const ArrayDouble1& array);
+    static void save (const File& file, const ArrayDoubleN& array);
+
+private:
+    static void write (const File& file, const double* data, const std::vector<std::size_t>& shape, bool fortranOrder);
+};
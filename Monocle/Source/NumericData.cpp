@@ -1,3 +1,6 @@
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
 #include <vector>
 #include "NumericData.hpp"
 
@@ -6,17 +9,118 @@
 
 //==============================================================================
 ArrayDouble1::ArrayDouble1() {}
-ArrayDouble1::ArrayDouble1 (nd::ndarray<double, 1> array) : array (array) {}
+ArrayDouble1::ArrayDouble1 (nd::ndarray<double, 1> array) : array (std::move (array)) {}
 ArrayDouble1::ArrayDouble1 (const std::vector<double>& vec) : array (int (vec.size()))
 {
-    std::memcpy (&array(0), &vec[0], vec.size() * sizeof (double));
+    if (! vec.empty())
+        std::memcpy (&array(0), &vec[0], vec.size() * sizeof (double));
+}
+
+ArrayDouble1::ArrayDouble1 (std::shared_ptr<const void> owner, const double* data, std::size_t size)
+: owner (owner)
+, external (data)
+, externalSize (size)
+{
+}
+
+ArrayDouble1::ArrayDouble1 (const ArrayDouble1& other, std::size_t start, std::size_t count)
+: externalSize (count)
+{
+    other.resolve();
+
+    if (other.owner)
+    {
+        owner = other.owner;
+        external = other.external + start;
+    }
+    else
+    {
+        // Copies of an ndarray share its buffer, so this one keeps it alive
+        // after the other array is appended to or released.
+        auto buffer = std::make_shared<nd::ndarray<double, 1>> (other.array);
+        owner = buffer;
+        external = count > 0 ? &(*buffer)(0) + start : nullptr;
+    }
+}
+
+ArrayDouble1::ArrayDouble1 (std::size_t size, std::function<nd::ndarray<double, 1>()> deferred)
+: deferred (deferred)
+, deferredSize (size)
+{
 }
 
 nd::ndarray<double, 1>& ArrayDouble1::get()
 {
+    resolve();
+
+    if (owner)
+    {
+        auto copy = nd::ndarray<double, 1> (int (externalSize));
+
+        if (externalSize > 0)
+            std::memcpy (&copy(0), external, externalSize * sizeof (double));
+
+        array.become (copy);
+        owner.reset();
+        growable.reset();
+        external = nullptr;
+        externalSize = 0;
+    }
     return array;
 }
 
+const double* ArrayDouble1::data() const
+{
+    resolve();
+
+    if (owner)
+        return external;
+
+    return array.size() > 0 ? &array(0) : nullptr;
+}
+
+std::size_t ArrayDouble1::size() const
+{
+    if (deferred)
+        return deferredSize;
+
+    return owner ? externalSize : array.size();
+}
+
+void ArrayDouble1::append (const double* values, std::size_t count)
+{
+    if (count == 0)
+        return;
+
+    resolve();
+
+    if (! growable || growable->capacity() - growable->size() < count)
+    {
+        auto size = this->size();
+        auto grown = std::make_shared<std::vector<double>>();
+        grown->reserve (std::max (size + count, size + size / 2));
+        grown->insert (grown->end(), data(), data() + size);
+        growable = grown;
+        array.become (nd::ndarray<double, 1>());
+    }
+
+    // The buffer is only written past its end, which views of it (holding the
+    // previous owner) never read, so it is not reallocated under them.
+    growable->insert (growable->end(), values, values + count);
+    owner = growable;
+    external = growable->data();
+    externalSize = growable->size();
+}
+
+void ArrayDouble1::resolve() const
+{
+    if (deferred)
+    {
+        array.become (deferred());
+        deferred = nullptr;
+    }
+}
+
 std::string ArrayDouble1::type() const
 {
     return "ArrayDouble1";
@@ -24,7 +128,7 @@ std::string ArrayDouble1::type() const
 
 std::string ArrayDouble1::describe() const
 {
-    return "double [" + std::to_string (array.shape()[0]) + "]";
+    return "double [" + std::to_string (size()) + "]";
 }
 
 std::string ArrayDouble1::serialize() const
@@ -36,3 +140,336 @@ bool ArrayDouble1::load (const std::string&)
 {
     return false;
 }
+
+long ArrayDouble1::extent() const
+{
+    return long (size());
+}
+
+bool ArrayDouble1::isDeferred() const
+{
+    return bool (deferred);
+}
+
+bool ArrayDouble1::isExternal() const
+{
+    return owner != nullptr && owner != growable;
+}
+
+
+
+
+//==============================================================================
+ArrayDoubleN::ArrayDoubleN (std::shared_ptr<ArrayDouble1> elements, std::vector<std::size_t> shape, Order order)
+: flat (elements)
+, extents (std::move (shape))
+, memoryOrder (order)
+{
+    auto count = std::size_t (1);
+
+    for (auto extent : extents)
+        count *= extent;
+
+    if (! flat || count != flat->size())
+        throw std::runtime_error ("shape does not match the number of elements");
+}
+
+const double* ArrayDoubleN::data() const
+{
+    return flat->data();
+}
+
+std::size_t ArrayDoubleN::size() const
+{
+    return flat->size();
+}
+
+std::size_t ArrayDoubleN::rank() const
+{
+    return extents.size();
+}
+
+const std::vector<std::size_t>& ArrayDoubleN::shape() const
+{
+    return extents;
+}
+
+ArrayDoubleN::Order ArrayDoubleN::order() const
+{
+    return memoryOrder;
+}
+
+std::vector<std::size_t> ArrayDoubleN::strides() const
+{
+    auto result = std::vector<std::size_t> (extents.size());
+    auto stride = std::size_t (1);
+
+    for (std::size_t n = 0; n < extents.size(); ++n)
+    {
+        auto axis = memoryOrder == Order::rowMajor ? extents.size() - 1 - n : n;
+        result[axis] = stride;
+        stride *= extents[axis];
+    }
+    return result;
+}
+
+std::shared_ptr<ArrayDouble1> ArrayDoubleN::elements() const
+{
+    return flat;
+}
+
+double ArrayDoubleN::operator() (std::size_t i, std::size_t j) const
+{
+    return memoryOrder == Order::rowMajor ? data()[i * extents[1] + j] : data()[i + j * extents[0]];
+}
+
+std::string ArrayDoubleN::type() const
+{
+    return "ArrayDoubleN";
+}
+
+std::string ArrayDoubleN::describe() const
+{
+    auto result = std::string ("double [");
+
+    for (std::size_t n = 0; n < extents.size(); ++n)
+        result += (n > 0 ? ", " : "") + std::to_string (extents[n]);
+
+    return result + (memoryOrder == Order::columnMajor ? "] (column-major)" : "]");
+}
+
+std::string ArrayDoubleN::serialize() const
+{
+    return "";
+}
+
+bool ArrayDoubleN::load (const std::string&)
+{
+    return false;
+}
+
+long ArrayDoubleN::extent() const
+{
+    return long (size());
+}
+
+
+
+
+//==============================================================================
+ArrayFloat1::ArrayFloat1() : values (std::make_shared<std::vector<float>>()) {}
+ArrayFloat1::ArrayFloat1 (std::vector<float> values) : values (std::make_shared<std::vector<float>> (std::move (values))) {}
+ArrayFloat1::ArrayFloat1 (std::size_t size, std::function<std::vector<float>()> deferred)
+: deferred (deferred)
+, deferredSize (size)
+{
+}
+
+const float* ArrayFloat1::data() const
+{
+    resolve();
+    return values->data();
+}
+
+std::size_t ArrayFloat1::size() const
+{
+    return deferred ? deferredSize : values->size();
+}
+
+std::shared_ptr<const std::vector<float>> ArrayFloat1::share() const
+{
+    resolve();
+    return values;
+}
+
+void ArrayFloat1::append (const float* appended, std::size_t count)
+{
+    if (count == 0)
+        return;
+
+    resolve();
+
+    if (values->capacity() - values->size() < count)
+    {
+        auto grown = std::make_shared<std::vector<float>>();
+        grown->reserve (std::max (values->size() + count, values->size() + values->size() / 2));
+        grown->insert (grown->end(), values->begin(), values->end());
+        values = grown;
+    }
+    values->insert (values->end(), appended, appended + count);
+}
+
+bool ArrayFloat1::isDeferred() const
+{
+    return bool (deferred);
+}
+
+void ArrayFloat1::resolve() const
+{
+    if (deferred)
+    {
+        values = std::make_shared<std::vector<float>> (deferred());
+        deferred = nullptr;
+    }
+}
+
+std::string ArrayFloat1::type() const
+{
+    return "ArrayFloat1";
+}
+
+std::string ArrayFloat1::describe() const
+{
+    return "float [" + std::to_string (size()) + "]";
+}
+
+std::string ArrayFloat1::serialize() const
+{
+    return "";
+}
+
+bool ArrayFloat1::load (const std::string&)
+{
+    return false;
+}
+
+long ArrayFloat1::extent() const
+{
+    return long (size());
+}
+
+
+
+//==============================================================================
+ArrayInt64::ArrayInt64 (std::vector<std::int64_t> values) : values (std::move (values)) {}
+
+const std::int64_t* ArrayInt64::data() const
+{
+    return values.data();
+}
+
+std::size_t ArrayInt64::size() const
+{
+    return values.size();
+}
+
+std::string ArrayInt64::type() const
+{
+    return "ArrayInt64";
+}
+
+std::string ArrayInt64::describe() const
+{
+    return "int64 [" + std::to_string (size()) + "]";
+}
+
+std::string ArrayInt64::serialize() const
+{
+    return "";
+}
+
+bool ArrayInt64::load (const std::string&)
+{
+    return false;
+}
+
+long ArrayInt64::extent() const
+{
+    return long (size());
+}
+
+
+
+
+//==============================================================================
+ArrayBool::ArrayBool (std::vector<std::uint8_t> values) : values (std::move (values)) {}
+
+const std::uint8_t* ArrayBool::data() const
+{
+    return values.data();
+}
+
+std::size_t ArrayBool::size() const
+{
+    return values.size();
+}
+
+std::string ArrayBool::type() const
+{
+    return "ArrayBool";
+}
+
+std::string ArrayBool::describe() const
+{
+    return "bool [" + std::to_string (size()) + "]";
+}
+
+std::string ArrayBool::serialize() const
+{
+    return "";
+}
+
+bool ArrayBool::load (const std::string&)
+{
+    return false;
+}
+
+long ArrayBool::extent() const
+{
+    return long (size());
+}
+
+
+
+
+//==============================================================================
+ArrayString::ArrayString (std::vector<std::string> dictionary, std::vector<std::int32_t> codes)
+: dictionary (std::move (dictionary))
+, indexes (std::move (codes))
+{
+}
+
+const std::string& ArrayString::operator[] (std::size_t index) const
+{
+    return dictionary[indexes[index]];
+}
+
+const std::vector<std::string>& ArrayString::getDictionary() const
+{
+    return dictionary;
+}
+
+const std::int32_t* ArrayString::codes() const
+{
+    return indexes.data();
+}
+
+std::size_t ArrayString::size() const
+{
+    return indexes.size();
+}
+
+std::string ArrayString::type() const
+{
+    return "ArrayString";
+}
+
+std::string ArrayString::describe() const
+{
+    return "string [" + std::to_string (size()) + "] (" + std::to_string (dictionary.size()) + " distinct)";
+}
+
+std::string ArrayString::serialize() const
+{
+    return "";
+}
+
+bool ArrayString::load (const std::string&)
+{
+    return false;
+}
+
+long ArrayString::extent() const
+{
+    return long (size());
+}
@@ -1,4 +1,9 @@
 #pragma once
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
 #include "Kernel/UserData.hpp"
 #include "3rdParty/ndarray/ndarray.hpp"
 
@@ -12,11 +17,222 @@ public:
     ArrayDouble1();
     ArrayDouble1 (nd::ndarray<double, 1> array);
     ArrayDouble1 (const std::vector<double>& vec);
+
+    /** Construct an array referencing size values at data, without copying
+        them. The data must remain valid for as long as owner is alive; owner
+        would typically be a memory-mapped file.
+     */
+    ArrayDouble1 (std::shared_ptr<const void> owner, const double* data, std::size_t size);
+
+    /** Construct a view of count values of another array, starting at start,
+        which shares the other array's memory rather than copying it. The view
+        keeps that memory alive, and is unaffected by values later appended to
+        the other array. start + count must not exceed the other's size.
+     */
+    ArrayDouble1 (const ArrayDouble1& other, std::size_t start, std::size_t count);
+
+    /** Construct an array of the given size whose values are produced by the
+        given function when they are first accessed. This allows columns of a
+        table that are never used to never be loaded.
+     */
+    ArrayDouble1 (std::size_t size, std::function<nd::ndarray<double, 1>()> deferred);
+
+    /** Return the data as an nd::ndarray. An array referencing external memory
+        is first copied into an ndarray that it owns.
+     */
     nd::ndarray<double, 1>& get();
+    const double* data() const;
+    std::size_t size() const;
+
+    /** Extend the array by the given values. The array object is modified in
+        place, so any holders of it see the appended data. The values are then
+        held in a buffer with spare capacity that grows geometrically, so that
+        repeated appends take time proportional to the number of values
+        appended rather than to the size of the array.
+     */
+    void append (const double* values, std::size_t count);
+    std::string type() const override;
+    std::string describe() const override;
+    std::string serialize() const override;
+    bool load (const std::string&) override;
+    long extent() const override;
+
+    /** Return true if the values have not yet been produced by the function
+        given to the deferred constructor.
+     */
+    bool isDeferred() const;
+
+    /** Return true if the values are referenced from memory owned by someone
+        else, such as a memory-mapped file, rather than held by the array.
+     */
+    bool isExternal() const;
+private:
+    void resolve() const;
+    mutable nd::ndarray<double, 1> array;
+    mutable std::function<nd::ndarray<double, 1>()> deferred;
+    std::size_t deferredSize = 0;
+    std::shared_ptr<const void> owner;
+    const double* external = nullptr;
+    std::size_t externalSize = 0;
+    std::shared_ptr<std::vector<double>> growable;
+};
+
+
+
+
+// ============================================================================
+/**
+An N-dimensional array of doubles, held as a one-dimensional ArrayDouble1 of
+its elements in memory order together with a shape and the order of the
+axes in memory. The elements are shared with the flat array, so they may be
+memory-mapped from a file or converted when first accessed, and reshaping an
+array or giving its elements to a one-dimensional function copies nothing.
+*/
+class ArrayDoubleN : public mcl::UserData
+{
+public:
+    enum class Order
+    {
+        /** The last index varies fastest, as in C and in NumPy by default. */
+        rowMajor,
+
+        /** The first index varies fastest, as in Fortran and FITS. */
+        columnMajor,
+    };
+
+    /** Construct an array with the given shape over the elements of a flat
+        array, whose size must be the product of the extents. Throws
+        std::runtime_error if it is not.
+     */
+    ArrayDoubleN (std::shared_ptr<ArrayDouble1> elements, std::vector<std::size_t> shape, Order order=Order::rowMajor);
+
+    const double* data() const;
+    std::size_t size() const;
+    std::size_t rank() const;
+    const std::vector<std::size_t>& shape() const;
+    Order order() const;
+
+    /** Return the distance, in elements, between consecutive values along
+        each axis.
+     */
+    std::vector<std::size_t> strides() const;
+
+    /** Return the flat array of the elements, in memory order. */
+    std::shared_ptr<ArrayDouble1> elements() const;
+
+    /** Return the element at row i and column j of a 2-d array. */
+    double operator() (std::size_t i, std::size_t j) const;
+
+    std::string type() const override;
+    std::string describe() const override;
+    std::string serialize() const override;
+    bool load (const std::string&) override;
+    long extent() const override;
+private:
+    std::shared_ptr<ArrayDouble1> flat;
+    std::vector<std::size_t> extents;
+    Order memoryOrder;
+};
+
+
+
+
+// ============================================================================
+/**
+A one-dimensional array of single-precision values, for data that does not
+need double precision and so can be held in half the memory. The values are
+held in a shared vector with spare capacity. Appending writes past the end of
+it when there is room, and otherwise replaces it with a larger one, so the
+values a holder of share() has seen (up to the size at the time) never
+change.
+*/
+class ArrayFloat1 : public mcl::UserData
+{
+public:
+    ArrayFloat1();
+    ArrayFloat1 (std::vector<float> values);
+
+    /** Construct an array of the given size whose values are produced by the
+        given function when they are first accessed.
+     */
+    ArrayFloat1 (std::size_t size, std::function<std::vector<float>()> deferred);
+
+    const float* data() const;
+    std::size_t size() const;
+    std::shared_ptr<const std::vector<float>> share() const;
+    void append (const float* values, std::size_t count);
+    std::string type() const override;
+    std::string describe() const override;
+    std::string serialize() const override;
+    bool load (const std::string&) override;
+    long extent() const override;
+    bool isDeferred() const;
+private:
+    void resolve() const;
+    mutable std::shared_ptr<std::vector<float>> values;
+    mutable std::function<std::vector<float>()> deferred;
+    std::size_t deferredSize = 0;
+};
+
+
+
+// ============================================================================
+class ArrayInt64 : public mcl::UserData
+{
+public:
+    ArrayInt64 (std::vector<std::int64_t> values);
+    const std::int64_t* data() const;
+    std::size_t size() const;
+    std::string type() const override;
+    std::string describe() const override;
+    std::string serialize() const override;
+    bool load (const std::string&) override;
+    long extent() const override;
+private:
+    std::vector<std::int64_t> values;
+};
+
+
+
+
+// ============================================================================
+class ArrayBool : public mcl::UserData
+{
+public:
+    ArrayBool (std::vector<std::uint8_t> values);
+    const std::uint8_t* data() const;
+    std::size_t size() const;
+    std::string type() const override;
+    std::string describe() const override;
+    std::string serialize() const override;
+    bool load (const std::string&) override;
+    long extent() const override;
+private:
+    std::vector<std::uint8_t> values;
+};
+
+
+
+
+// ============================================================================
+/**
+An array of strings, stored dictionary-encoded: each element is an index into a
+list of the distinct strings in the array.
+*/
+class ArrayString : public mcl::UserData
+{
+public:
+    ArrayString (std::vector<std::string> dictionary, std::vector<std::int32_t> codes);
+    const std::string& operator[] (std::size_t index) const;
+    const std::vector<std::string>& getDictionary() const;
+    const std::int32_t* codes() const;
+    std::size_t size() const;
     std::string type() const override;
     std::string describe() const override;
     std::string serialize() const override;
     bool load (const std::string&) override;
+    long extent() const override;
 private:
-    nd::ndarray<double, 1> array;
+    std::vector<std::string> dictionary;
+    std::vector<std::int32_t> indexes;
 };
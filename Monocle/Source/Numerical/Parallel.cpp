@@ -0,0 +1,162 @@
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "Parallel.hpp"
+
+
+
+
+// ============================================================================
+/*
+ A loop being run. Threads claim its indices from next until they run out, and
+ the caller waits until numDone reaches count.
+ */
+struct Loop
+{
+    std::function<void (std::size_t)> function;
+    std::size_t count = 0;
+    std::atomic<std::size_t> next { 0 };
+    std::atomic<bool> failed { false };
+    std::exception_ptr error;
+    std::size_t numDone = 0;
+    std::mutex mutex;
+    std::condition_variable finished;
+};
+
+/**
+ Run the indices of a loop until there are none left to claim, and return
+ whether any were claimed.
+ */
+static bool runIndices (Loop& loop)
+{
+    auto numRun = std::size_t (0);
+
+    for (auto n = loop.next++; n < loop.count; n = loop.next++)
+    {
+        if (! loop.failed)
+        {
+            try {
+                loop.function (n);
+            }
+            catch (...)
+            {
+                std::lock_guard<std::mutex> lock (loop.mutex);
+
+                if (! loop.failed)
+                    loop.error = std::current_exception();
+
+                loop.failed = true;
+            }
+        }
+        ++numRun;
+    }
+
+    if (numRun > 0)
+    {
+        std::lock_guard<std::mutex> lock (loop.mutex);
+        loop.numDone += numRun;
+
+        if (loop.numDone == loop.count)
+            loop.finished.notify_all();
+    }
+    return numRun > 0;
+}
+
+
+
+
+// ============================================================================
+/*
+ The workers wait for loops to be queued, and take indices from the oldest one
+ until it has none left, at which point it is dropped from the queue.
+ */
+class WorkerPool
+{
+public:
+    WorkerPool (std::size_t numWorkers)
+    {
+        for (std::size_t n = 0; n < numWorkers; ++n)
+            workers.emplace_back ([this] { run(); });
+    }
+
+    void submit (std::shared_ptr<Loop> loop)
+    {
+        {
+            std::lock_guard<std::mutex> lock (mutex);
+            loops.push_back (loop);
+        }
+        available.notify_all();
+    }
+
+private:
+    void run()
+    {
+        while (true)
+        {
+            auto loop = std::shared_ptr<Loop>();
+            {
+                std::unique_lock<std::mutex> lock (mutex);
+                available.wait (lock, [this] { return ! loops.empty(); });
+                loop = loops.front();
+            }
+            if (! runIndices (*loop))
+            {
+                std::lock_guard<std::mutex> lock (mutex);
+                loops.erase (std::remove (loops.begin(), loops.end(), loop), loops.end());
+            }
+        }
+    }
+
+    std::vector<std::thread> workers;
+    std::deque<std::shared_ptr<Loop>> loops;
+    std::mutex mutex;
+    std::condition_variable available;
+};
+
+
+
+
+// ============================================================================
+std::size_t Parallel::numThreads()
+{
+    static const auto n = std::size_t (std::max (1u, std::thread::hardware_concurrency()));
+    return n;
+}
+
+void Parallel::forEach (std::size_t count, std::function<void (std::size_t)> function)
+{
+    if (count == 0)
+    {
+        return;
+    }
+    if (count == 1 || numThreads() == 1)
+    {
+        for (std::size_t n = 0; n < count; ++n)
+            function (n);
+        return;
+    }
+
+    // The pool is never destroyed, since its workers may still be waiting on
+    // it while static objects are destroyed at exit.
+    static auto pool = new WorkerPool (numThreads() - 1);
+
+    auto loop = std::make_shared<Loop>();
+    loop->function = std::move (function);
+    loop->count = count;
+    pool->submit (loop);
+    runIndices (*loop);
+
+    std::unique_lock<std::mutex> lock (loop->mutex);
+    loop->finished.wait (lock, [&loop] { return loop->numDone == loop->count; });
+
+    if (loop->error)
+    {
+        std::rethrow_exception (loop->error);
+    }
+}
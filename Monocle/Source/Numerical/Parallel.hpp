@@ -0,0 +1,31 @@
+#pragma once
+#include <cstddef>
+#include <functional>
+
+
+
+
+// ============================================================================
+/**
+Runs loops in parallel on a pool of worker threads that is started on first
+use and kept for the life of the process, so that a parallel loop costs a
+wakeup rather than a thread creation per iteration.
+
+The calling thread takes iterations as well as the workers, so a loop always
+makes progress, even when every worker is busy with another loop or the loop
+is nested inside one.
+*/
+class Parallel
+{
+public:
+    /** Return the number of threads that a loop runs on: one per hardware
+        thread, counting the caller.
+     */
+    static std::size_t numThreads();
+
+    /** Call the function for each index in [0, count), in parallel, and return
+        once every call has. If any call throws, the indices not yet started
+        are skipped, and the first exception is rethrown.
+     */
+    static void forEach (std::size_t count, std::function<void (std::size_t)> function);
+};
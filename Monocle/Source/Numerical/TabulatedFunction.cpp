@@ -172,40 +172,11 @@ TabulatedFunction TabulatedFunction::makeHistogram (
         }
     }
 
-    // Returns the index of the bin edge to the right of the sample position
-    // (lowest possible value is 1).
-
-    auto findBinIndex = [=] (double x)
-    {
-        switch (spacingMode)
-        {
-            case BinSpacingMode::useEqualBinWidthsLinear:
-            {
-                double x0 = binEdges.front();
-                double x1 = binEdges.back();
-                return 0 + int ((x - x0) / (x1 - x0) * (binEdges.size() - 1));
-            }
-            case BinSpacingMode::useEqualBinWidthsLogarithmic:
-            {
-                double L0 = std::log (binEdges.front());
-                double L1 = std::log (binEdges.back());
-                return 0 + int ((std::log (x) - L0) / (L1 - L0) * (binEdges.size() - 1));
-            }
-            default:
-            {
-                return -1;
-            }
-        }
-    };
-
     double sampleMass = normalize ? 1.0 / samples.size() : 1.0;
 
     for (int n = 0; n < samples.size(); ++n)
     {
-        long binIndex = findBinIndex (samples[n]);
-
-        if (binIndex < 0) binIndex = 0;
-        if (binIndex >= binEdges.size() - 1) binIndex = binEdges.size() - 2;
+        long binIndex = findHistogramBinIndex (binEdges, spacingMode, samples[n]);
 
         if (density)
         {
@@ -242,6 +213,87 @@ TabulatedFunction TabulatedFunction::makeHistogram (
     }
 }
 
+bool TabulatedFunction::addSamplesToHistogram (const double* samples,
+                                               size_t numberOfSamples,
+                                               size_t numberOfPreviousSamples,
+                                               bool density,
+                                               bool normalize)
+{
+    if (xdata.size() < 2)
+    {
+        return false;
+    }
+
+    for (size_t n = 0; n < numberOfSamples; ++n)
+    {
+        if (! (samples[n] >= xdata.front() && samples[n] <= xdata.back()))
+        {
+            return false;
+        }
+    }
+
+    size_t numberOfTotalSamples = numberOfPreviousSamples + numberOfSamples;
+    double sampleMass = normalize ? 1.0 / numberOfTotalSamples : 1.0;
+
+    if (normalize && numberOfTotalSamples > 0)
+    {
+        for (auto& y : ydata)
+        {
+            y *= double (numberOfPreviousSamples) / numberOfTotalSamples;
+        }
+    }
+
+    for (size_t n = 0; n < numberOfSamples; ++n)
+    {
+        long binIndex = findHistogramBinIndex (xdata, spacingMode, samples[n]);
+
+        if (density)
+        {
+            ydata[binIndex] += sampleMass / (xdata[binIndex + 1] - xdata[binIndex]);
+        }
+        else
+        {
+            ydata[binIndex] += sampleMass;
+        }
+    }
+    return true;
+}
+
+long TabulatedFunction::findHistogramBinIndex (const std::vector<double>& binEdges, BinSpacingMode spacingMode, double x)
+{
+    // Returns the index of the bin whose left edge is at or below the sample
+    // position, clamped to the valid bins.
+
+    long binIndex = -1;
+
+    switch (spacingMode)
+    {
+        case BinSpacingMode::useEqualBinWidthsLinear:
+        {
+            double x0 = binEdges.front();
+            double x1 = binEdges.back();
+            binIndex = 0 + long ((x - x0) / (x1 - x0) * (binEdges.size() - 1));
+            break;
+        }
+        case BinSpacingMode::useEqualBinWidthsLogarithmic:
+        {
+            double L0 = std::log (binEdges.front());
+            double L1 = std::log (binEdges.back());
+            binIndex = 0 + long ((std::log (x) - L0) / (L1 - L0) * (binEdges.size() - 1));
+            break;
+        }
+        default:
+        {
+            break;
+        }
+    }
+
+    if (binIndex < 0) binIndex = 0;
+    if (binIndex >= long (binEdges.size()) - 1) binIndex = binEdges.size() - 2;
+
+    return binIndex;
+}
+
 size_t TabulatedFunction::size() const
 {
     return xdata.size();
@@ -79,6 +79,21 @@ public:
                                             bool normalize=false,
                                             bool shift=false);
 
+    /**
+        Add samples to a histogram that was created by makeHistogram with
+        shift set to false, keeping its bin edges. If any of the samples lies
+        outside the range of the bin edges, the table is left unchanged and
+        false is returned, because a histogram of all the samples would have
+        different bins. If normalize is true, numberOfPreviousSamples must be
+        the number of samples already in the histogram; the existing masses
+        are then rescaled so that the total mass remains 1.
+    */
+    bool addSamplesToHistogram (const double* samples,
+                                size_t numberOfSamples,
+                                size_t numberOfPreviousSamples,
+                                bool density=false,
+                                bool normalize=false);
+
     /**
         Return the number of entries in the table.
     */
@@ -155,6 +170,7 @@ public:
     void outputTable (std::ostream& stream, std::function<double (double)> exactYfunction) const;
 
 private:
+    static long findHistogramBinIndex (const std::vector<double>& binEdges, BinSpacingMode spacingMode, double x);
     std::vector<double> xdata;
     std::vector<double> ydata;
     BinSpacingMode spacingMode;
@@ -0,0 +1,400 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include "VectorMath.hpp"
+
+
+
+
+// ============================================================================
+/*
+ Adding this constant to a double of magnitude below 2^51 rounds it to the
+ nearest integer k, leaving k in the low bits of the sum, since the spacing of
+ doubles at 1.5 * 2^52 is exactly one.
+ */
+static const double roundingMagic = 6755399441055744.0;
+
+static const double ln2Hi = 6.93147180369123816490e-01;
+static const double ln2Lo = 1.90821492927058770002e-10;
+static const double invLn2 = 1.44269504088896338700e+00;
+static const double invLn2Hi = 1.44269504072144627571e+00;
+static const double invLn2Lo = 1.67517131648865118353e-10;
+static const double invLn10Hi = 4.34294481878168880939e-01;
+static const double invLn10Lo = 2.50829467116452752298e-11;
+static const double log10Of2Hi = 3.01029995663611771306e-01;
+static const double log10Of2Lo = 3.69423907715893078616e-13;
+static const double halfSqrt2 = 7.07106781186547524401e-01;
+
+/* Three parts of pi / 2, the first two of 33 bits, so that their products
+   with a quadrant number below 2^20 are exact. */
+static const double twoOverPi = 6.36619772367581382433e-01;
+static const double piOver2Part1 = 1.57079632673412561417e+00;
+static const double piOver2Part2 = 6.07710050630396597660e-11;
+static const double piOver2Part3 = 2.02226624871116645580e-21;
+
+/* Taylor coefficients of exp (r) for |r| <= ln (2) / 2. */
+static const double expCoefficients[] = {
+    1.0, 1.0, 1.0 / 2, 1.0 / 6, 1.0 / 24, 1.0 / 120, 1.0 / 720, 1.0 / 5040,
+    1.0 / 40320, 1.0 / 362880, 1.0 / 3628800, 1.0 / 39916800,
+    1.0 / 479001600, 1.0 / 6227020800 };
+
+/* Minimax coefficients of (log (1 + f) - f + f^2 / 2) in s = f / (2 + f),
+   from fdlibm, split into the odd and even powers of s^2. */
+static const double logOddCoefficients[] = {
+    6.666666666666735130e-01, 2.857142874366239149e-01,
+    1.818357216161805012e-01, 1.479819860511658591e-01 };
+
+static const double logEvenCoefficients[] = {
+    3.999999999940941908e-01, 2.222219843214978396e-01,
+    1.531383769920937332e-01 };
+
+/* Minimax coefficients of sin (r) and cos (r) for |r| <= pi / 4, from fdlibm. */
+static const double sinCoefficients[] = {
+   -1.66666666666666324348e-01, 8.33333333332248946124e-03,
+   -1.98412698298579493134e-04, 2.75573137070700676789e-06,
+   -2.50507602534068634195e-08, 1.58969099521155010221e-10 };
+
+static const double cosCoefficients[] = {
+    4.16666666666666019037e-02, -1.38888888888741095749e-03,
+    2.48015872894767294178e-05, -2.75573143513906633035e-07,
+    2.08757232129817482790e-09, -1.13596475577881948265e-11 };
+
+
+
+
+// ============================================================================
+static inline std::uint64_t toBits (double x)
+{
+    std::uint64_t bits;
+    std::memcpy (&bits, &x, sizeof (double));
+    return bits;
+}
+
+static inline double fromBits (std::uint64_t bits)
+{
+    double x;
+    std::memcpy (&x, &bits, sizeof (double));
+    return x;
+}
+
+/**
+ Return a where the mask is all ones and b where it is zero, without a branch
+ that would keep the loop around it from being vectorized.
+ */
+static inline double select (std::uint64_t mask, double a, double b)
+{
+    return fromBits ((toBits (a) & mask) | (toBits (b) & ~mask));
+}
+
+template<std::size_t N>
+static inline double horner (double x, const double (&c)[N])
+{
+    auto p = c[N - 1];
+
+    for (auto n = N - 1; n > 0; --n)
+        p = p * x + c[n - 1];
+
+    return p;
+}
+
+/**
+ Write approximate (x[i]) to y[i], and then exact (x[i]) where isInRange (x[i])
+ is false. The work is done in blocks small enough that the second pass reads
+ from the cache, and so that the first pass has no branches.
+ */
+template<typename Approximate, typename IsInRange, typename Exact>
+static void evaluate (const double* x, double* y, std::size_t size, Approximate approximate, IsInRange isInRange, Exact exact)
+{
+    const std::size_t blockSize = 512;
+
+    for (std::size_t start = 0; start < size; start += blockSize)
+    {
+        auto end = std::min (size, start + blockSize);
+
+        for (auto i = start; i < end; ++i)
+            y[i] = approximate (x[i]);
+
+        for (auto i = start; i < end; ++i)
+            if (! isInRange (x[i]))
+                y[i] = exact (x[i]);
+    }
+}
+
+
+
+
+// ============================================================================
+/**
+ Return exp (x) for |x| < 708, where neither the result nor its scale factor
+ 2^k is subnormal or infinite.
+ */
+static inline double expKernel (double x)
+{
+    auto kd = x * invLn2 + roundingMagic;
+    auto k = kd - roundingMagic;
+    auto r = (x - k * ln2Hi) - k * ln2Lo;
+    auto scale = fromBits ((toBits (kd) - toBits (roundingMagic) + 1023) << 52);
+    return horner (r, expCoefficients) * scale;
+}
+
+/**
+ Split a positive normal x into 2^e * (1 + f), with 1 + f in [sqrt(2)/2,
+ sqrt(2)), by offsetting its bits so that the exponent field rounds at
+ sqrt(2)/2 rather than 1. Return log (1 + f) as hi + lo, where hi has only
+ its leading 21 bits, so that its products with the leading parts of
+ constants are exact.
+ */
+static inline double logKernel (double x, double& e, double& lo)
+{
+    auto shifted = toBits (x) + (0x3ff0000000000000ull - toBits (halfSqrt2));
+    auto biasedExponent = shifted >> 52;
+    auto m = fromBits (toBits (x) - ((biasedExponent - 1023) << 52));
+    e = fromBits (biasedExponent | 0x4330000000000000ull) - 4503599627371519.0;
+
+    auto f = m - 1.0;
+    auto s = f / (2.0 + f);
+    auto z = s * s;
+    auto w = z * z;
+    auto R = z * horner (w, logOddCoefficients) + w * horner (w, logEvenCoefficients);
+    auto hfsq = 0.5 * f * f;
+    auto hi = fromBits (toBits (f - hfsq) & 0xffffffff00000000ull);
+
+    lo = (f - hi) - hfsq + s * (hfsq + R);
+    return hi;
+}
+
+/**
+ Return e * c + (hi + lo) / ln (b), where c = log_b (2) and cHi, invLnHi are
+ the leading parts of c and 1 / ln (b), summing the large terms with their
+ rounding errors.
+ */
+static inline double scaledLog (double e, double hi, double lo, double cHi, double cLo, double invLnHi, double invLnLo)
+{
+    auto high = hi * invLnHi;
+    auto low = (lo + hi) * invLnLo + lo * invLnHi + e * cLo;
+    auto eHigh = e * cHi;
+    auto sum = eHigh + high;
+    return sum + (low + ((eHigh - sum) + high));
+}
+
+static inline bool isPositiveNormal (double x)
+{
+    return x >= std::numeric_limits<double>::min() && x <= std::numeric_limits<double>::max();
+}
+
+/**
+ Reduce x to r in [-pi/4, pi/4], returning r and setting quadrant to the
+ number of times pi/2 was subtracted, for |x| < 1e6.
+ */
+static inline double reduceAngle (double x, std::uint64_t& quadrant)
+{
+    auto kd = x * twoOverPi + roundingMagic;
+    auto k = kd - roundingMagic;
+    quadrant = toBits (kd);
+    return ((x - k * piOver2Part1) - k * piOver2Part2) - k * piOver2Part3;
+}
+
+static inline double sinKernel (double r)
+{
+    auto z = r * r;
+    return r + z * r * horner (z, sinCoefficients);
+}
+
+static inline double cosKernel (double r)
+{
+    auto z = r * r;
+    auto hz = 0.5 * z;
+    auto w = 1.0 - hz;
+    return w + (((1.0 - w) - hz) + z * z * horner (z, cosCoefficients));
+}
+
+/**
+ Return the sine of the reduced angle r in the given quadrant, which for the
+ cosine is one more than that of the angle.
+ */
+static inline double sinQuadrant (double r, std::uint64_t quadrant)
+{
+    auto v = select (0 - (quadrant & 1), cosKernel (r), sinKernel (r));
+    return fromBits (toBits (v) ^ ((quadrant & 2) << 62));
+}
+
+static inline bool isSmallAngle (double x)
+{
+    return std::fabs (x) < 1e6;
+}
+
+/**
+ The odd functions are left to the standard library at zero, which keeps the
+ sign of -0.
+ */
+static inline bool isSmallNonzeroAngle (double x)
+{
+    return x != 0.0 && std::fabs (x) < 1e6;
+}
+
+
+
+
+// ============================================================================
+void VectorMath::exp (const double* x, double* y, std::size_t size)
+{
+    evaluate (x, y, size,
+              [] (double v) { return expKernel (v); },
+              [] (double v) { return std::fabs (v) < 708.0; },
+              [] (double v) { return std::exp (v); });
+}
+
+void VectorMath::log (const double* x, double* y, std::size_t size)
+{
+    auto approximate = [] (double v)
+    {
+        double e, lo;
+        auto hi = logKernel (v, e, lo);
+        return e * ln2Hi + (hi + (lo + e * ln2Lo));
+    };
+    evaluate (x, y, size, approximate, isPositiveNormal, [] (double v) { return std::log (v); });
+}
+
+void VectorMath::log10 (const double* x, double* y, std::size_t size)
+{
+    auto approximate = [] (double v)
+    {
+        double e, lo;
+        auto hi = logKernel (v, e, lo);
+        return scaledLog (e, hi, lo, log10Of2Hi, log10Of2Lo, invLn10Hi, invLn10Lo);
+    };
+    evaluate (x, y, size, approximate, isPositiveNormal, [] (double v) { return std::log10 (v); });
+}
+
+void VectorMath::log2 (const double* x, double* y, std::size_t size)
+{
+    auto approximate = [] (double v)
+    {
+        double e, lo;
+        auto hi = logKernel (v, e, lo);
+        return scaledLog (e, hi, lo, 1.0, 0.0, invLn2Hi, invLn2Lo);
+    };
+    evaluate (x, y, size, approximate, isPositiveNormal, [] (double v) { return std::log2 (v); });
+}
+
+void VectorMath::sin (const double* x, double* y, std::size_t size)
+{
+    auto approximate = [] (double v)
+    {
+        std::uint64_t quadrant;
+        auto r = reduceAngle (v, quadrant);
+        return sinQuadrant (r, quadrant);
+    };
+    evaluate (x, y, size, approximate, isSmallNonzeroAngle, [] (double v) { return std::sin (v); });
+}
+
+void VectorMath::cos (const double* x, double* y, std::size_t size)
+{
+    auto approximate = [] (double v)
+    {
+        std::uint64_t quadrant;
+        auto r = reduceAngle (v, quadrant);
+        return sinQuadrant (r, quadrant + 1);
+    };
+    evaluate (x, y, size, approximate, isSmallAngle, [] (double v) { return std::cos (v); });
+}
+
+void VectorMath::tan (const double* x, double* y, std::size_t size)
+{
+    auto approximate = [] (double v)
+    {
+        std::uint64_t quadrant;
+        auto r = reduceAngle (v, quadrant);
+        auto s = sinKernel (r);
+        auto c = cosKernel (r);
+        auto isOdd = 0 - (quadrant & 1);
+        return select (isOdd, -c, s) / select (isOdd, s, c);
+    };
+    evaluate (x, y, size, approximate, isSmallNonzeroAngle, [] (double v) { return std::tan (v); });
+}
+
+
+
+
+// ============================================================================
+#include <cassert>
+#include <random>
+#include <vector>
+
+/**
+ Return the number of doubles between two results, or zero if both are NaN.
+ */
+static std::uint64_t ulpsBetween (double a, double b)
+{
+    if (std::isnan (a) || std::isnan (b))
+        return std::isnan (a) && std::isnan (b) ? 0 : std::numeric_limits<std::uint64_t>::max();
+
+    if (a == b)
+        return 0;
+
+    auto signBit = std::uint64_t (1) << 63;
+    auto key = [signBit] (double x)
+    {
+        std::uint64_t bits;
+        std::memcpy (&bits, &x, sizeof (double));
+        return bits & signBit ? ~bits : bits ^ signBit;
+    };
+    return key (a) > key (b) ? key (a) - key (b) : key (b) - key (a);
+}
+
+/**
+ Return the largest difference in ulps between a function and the standard
+ library over the given arguments.
+ */
+static std::uint64_t maxUlps (void (*f) (const double*, double*, std::size_t), double (*reference) (double), const std::vector<double>& x)
+{
+    auto y = std::vector<double> (x.size());
+    auto worst = std::uint64_t (0);
+    f (x.data(), y.data(), x.size());
+
+    for (std::size_t n = 0; n < x.size(); ++n)
+        worst = std::max (worst, ulpsBetween (y[n], reference (x[n])));
+
+    return worst;
+}
+
+void VectorMath::testAccuracy()
+{
+    auto random = std::mt19937 (11);
+    auto uniform = [&random] (double a, double b) { return std::uniform_real_distribution<double> (a, b) (random); };
+    auto inf = std::numeric_limits<double>::infinity();
+    auto nan = std::numeric_limits<double>::quiet_NaN();
+    auto denormal = std::numeric_limits<double>::denorm_min();
+    auto special = std::vector<double> { 0.0, -0.0, 1.0, -1.0, inf, -inf, nan, denormal, -denormal, 1e-310, 1e300, -1e300 };
+
+    auto exponents = special;
+    auto positives = special;
+    auto angles = special;
+
+    for (int n = 0; n < 20000; ++n)
+    {
+        exponents.push_back (uniform (-745.0, 710.0));
+        positives.push_back (std::pow (10.0, uniform (-307.0, 308.0)));
+        positives.push_back (uniform (0.5, 2.0));
+        angles.push_back (uniform (-10.0, 10.0));
+        angles.push_back (uniform (-1e6, 1e6));
+    }
+
+    assert (maxUlps (exp,   [] (double x) { return std::exp (x); },   exponents) <= 1);
+    assert (maxUlps (log,   [] (double x) { return std::log (x); },   positives) <= 1);
+    assert (maxUlps (log2,  [] (double x) { return std::log2 (x); },  positives) <= 1);
+    assert (maxUlps (log10, [] (double x) { return std::log10 (x); }, positives) <= 2);
+    assert (maxUlps (sin,   [] (double x) { return std::sin (x); },   angles) <= 2);
+    assert (maxUlps (cos,   [] (double x) { return std::cos (x); },   angles) <= 2);
+    assert (maxUlps (tan,   [] (double x) { return std::tan (x); },   angles) <= 4);
+
+    // The results keep the sign of zero, and of the infinities of log.
+    auto zeros = std::vector<double> { -0.0, 0.0 };
+    auto y = std::vector<double> (2);
+    sin (zeros.data(), y.data(), 2);
+    assert (std::signbit (y[0]) && ! std::signbit (y[1]));
+    log (zeros.data(), y.data(), 2);
+    assert (y[0] == -inf && y[1] == -inf);
+}
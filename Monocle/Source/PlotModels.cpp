@@ -1,3 +1,5 @@
+#include <cmath>
+#include <limits>
 #include "PlotModels.hpp"
 
 
@@ -74,16 +76,67 @@ FigureModel FigureModel::createExample()
 
 
 
+//==============================================================================
+void ImagePlotModel::createImage()
+{
+    auto ni = int (scalar->shape()[0]);
+    auto nj = int (scalar->shape()[1]);
+    auto range = vmax > vmin ? vmax - vmin : 1.0;
+    auto isGrey = colorMap.r.size() == 0 || colorMap.g.size() == 0 || colorMap.b.size() == 0;
+
+    image = Image (Image::ARGB, jmax (1, nj), jmax (1, ni), true);
+    Image::BitmapData bitmap (image, Image::BitmapData::writeOnly);
+
+    for (int i = 0; i < ni; ++i)
+    {
+        for (int j = 0; j < nj; ++j)
+        {
+            auto v = (*scalar) (std::size_t (i), std::size_t (j));
+
+            if (std::isnan (v))
+                continue;
+
+            auto t = float (jlimit (0.0, 1.0, (v - vmin) / range));
+            auto colour = isGrey ? Colour::greyLevel (t) : Colour::fromFloatRGBA (float (colorMap.r.lookupFunctionValue (t)),
+                                                                                float (colorMap.g.lookupFunctionValue (t)),
+                                                                                float (colorMap.b.lookupFunctionValue (t)), 1.f);
+            bitmap.setPixelColour (j, ni - 1 - i, colour);
+        }
+    }
+}
+
+
+
+
 //==============================================================================
 #include "NumericData.hpp"
 #include "Kernel/Builtin.hpp"
 
 using namespace mcl;
 
+/**
+ Point a plot column at a snapshot of the array argument at the given index,
+ sharing its values rather than copying or converting them.
+ */
+static void setColumn (PlotColumn& column, const Object::List& args, int index)
+{
+    if (index < int (args.size()) && args[index].type() == 'U')
+    {
+        if (auto floats = dynamic_cast<ArrayFloat1*> (args[index].get<Object::Data>().v.get()))
+        {
+            column.become (floats->share(), floats->size());
+            return;
+        }
+    }
+    const auto& doubles = Builtin::check_user_data<ArrayDouble1> (args, index);
+    column.become (std::make_shared<ArrayDouble1> (doubles, 0, doubles.size()));
+}
+
 Object::Dict PlotModels::plot_models()
 {
     Object::Dict m;
     m["line-plot"] = Object::Func (line_plot, "(line-plot x:{array} y:{array})");
+    m["image-plot"] = Object::Func (image_plot, "(image-plot z:{ArrayDoubleN} vmin={number} vmax={number} extent={list})");
     m["figure"] = Object::Func (figure, "(figure plots... format={dict})");
     return m;
 }
@@ -91,10 +144,8 @@ Object::Dict PlotModels::plot_models()
 Object PlotModels::line_plot (const Object::List& args, const Object::Dict&)
 {
     auto model = std::make_shared<LinePlotModel>();
-    auto x = Builtin::check_user_data<ArrayDouble1> (args, 0);
-    auto y = Builtin::check_user_data<ArrayDouble1> (args, 1);
-    model->x.become (x.get());
-    model->y.become (y.get());
+    setColumn (model->x, args, 0);
+    setColumn (model->y, args, 1);
 
     if (model->x.size() != model->y.size())
     {
@@ -103,12 +154,81 @@ Object PlotModels::line_plot (const Object::List& args, const Object::Dict&)
     return Object::data (model);
 }
 
+static double toNumber (const Object& value, const std::string& key)
+{
+    switch (value.type())
+    {
+        case 'i': return value.get<int>();
+        case 'd': return value.get<double>();
+        default: throw std::runtime_error ("wrong data type (" + std::string (1, value.type()) + ") for keyword " + key);
+    }
+}
+
+static double numberKwarg (const Object::Dict& kwar, const std::string& key, double defaultValue)
+{
+    auto item = kwar.find (key);
+    return item == kwar.end() ? defaultValue : toNumber (item->second, key);
+}
+
+/**
+ An image plot of a 2-d array. The colour range defaults to the range of the
+ values, and the extent (x0 x1 y0 y1) to one unit per element.
+ */
+Object PlotModels::image_plot (const Object::List& args, const Object::Dict& kwar)
+{
+    auto model = std::make_shared<ImagePlotModel>();
+    auto& z = Builtin::check_user_data<ArrayDoubleN> (args, 0);
+
+    if (z.rank() != 2)
+    {
+        throw std::runtime_error ("image-plot requires a 2-d array");
+    }
+    auto lower = std::numeric_limits<double>::max();
+    auto upper = std::numeric_limits<double>::lowest();
+    auto values = z.data();
+
+    for (std::size_t n = 0; n < z.size(); ++n)
+    {
+        lower = values[n] < lower ? values[n] : lower;
+        upper = values[n] > upper ? values[n] : upper;
+    }
+    auto extent = std::vector<double> { 0.0, double (z.shape()[1]), 0.0, double (z.shape()[0]) };
+
+    if (kwar.count ("extent"))
+    {
+        auto items = kwar.at ("extent").type() == 'L' ? kwar.at ("extent").get<Object::List>() : Object::List();
+
+        if (items.size() != 4)
+        {
+            throw std::runtime_error ("extent must be a list (x0 x1 y0 y1)");
+        }
+        for (int n = 0; n < 4; ++n)
+        {
+            extent[n] = toNumber (items[n], "extent");
+        }
+    }
+    model->scalar = std::dynamic_pointer_cast<ArrayDoubleN> (args[0].get<Object::Data>().v);
+    model->extent = Rectangle<double>::leftTopRightBottom (extent[0], extent[2], extent[1], extent[3]);
+    model->vmin = numberKwarg (kwar, "vmin", lower <= upper ? lower : 0.0);
+    model->vmax = numberKwarg (kwar, "vmax", lower <= upper ? upper : 1.0);
+    model->createImage();
+    return Object::data (model);
+}
+
 Object PlotModels::figure (const Object::List& args, const Object::Dict&)
 {
     auto fig = std::make_shared<FigureModel>();
 
     for (int n = 0; n < args.size(); ++n)
     {
+        if (args[n].type() == 'U')
+        {
+            if (auto imagePlot = dynamic_cast<ImagePlotModel*> (args[n].get<Object::Data>().v.get()))
+            {
+                fig->imagePlots.add (*imagePlot);
+                continue;
+            }
+        }
         auto plotModel = Builtin::check_user_data<LinePlotModel> (args, n);
         fig->linePlots.add (plotModel);
     }
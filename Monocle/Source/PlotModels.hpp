@@ -4,6 +4,7 @@
 #include "3rdParty/ndarray/ndarray.hpp"
 #include "Kernel/UserData.hpp"
 #include "Kernel/Object.hpp"
+#include "NumericData.hpp"
 
 
 
@@ -26,11 +27,59 @@ struct ColourMap
 
 
 
+//==============================================================================
+/**
+A column of plot coordinates, holding either double-precision values or a
+shared snapshot of single-precision values, so that float arrays are plotted
+without being converted to double. Snapshots of arrays record their size, so
+values later appended to the arrays are not seen.
+*/
+class PlotColumn
+{
+public:
+    void become (const nd::ndarray<double, 1>& values)
+    {
+        doubles.become (values);
+        view = nullptr;
+        floats = nullptr;
+        count = int (values.size());
+    }
+
+    void become (std::shared_ptr<const ArrayDouble1> values)
+    {
+        doubles.become (nd::ndarray<double, 1>());
+        view = values;
+        floats = nullptr;
+        count = int (values->size());
+    }
+
+    void become (std::shared_ptr<const std::vector<float>> values, std::size_t size)
+    {
+        doubles.become (nd::ndarray<double, 1>());
+        view = nullptr;
+        floats = values;
+        count = int (size);
+    }
+
+    int size() const { return count; }
+    bool empty() const { return size() == 0; }
+    double operator() (int n) const { return floats ? (*floats)[n] : view ? view->data()[n] : doubles(n); }
+
+private:
+    nd::ndarray<double, 1> doubles;
+    std::shared_ptr<const ArrayDouble1> view;
+    std::shared_ptr<const std::vector<float>> floats;
+    int count = 0;
+};
+
+
+
+
 //==============================================================================
 struct LinePlotModel : public mcl::UserData
 {
-    nd::ndarray<double, 1> x;
-    nd::ndarray<double, 1> y;
+    PlotColumn x;
+    PlotColumn y;
     float         lineWidth    = 1.f;
     float         markerSize   = 1.f;
     Colour        lineColour   = Colours::black;
@@ -92,14 +141,31 @@ struct HistogramModel
 
 
 //==============================================================================
-struct ImagePlotModel
+/**
+An image of the values of a 2-d array, whose rows run up the y axis and
+columns along the x axis, covering the given extent of the domain. The values
+are shared with the array rather than copied, and are mapped to colours from
+vmin to vmax once, when the image is created, so that painting only scales it.
+*/
+struct ImagePlotModel : public mcl::UserData
 {
-    Array<double> scalar;
-    unsigned int  ni   = 0;
-    unsigned int  nj   = 0;
+    std::shared_ptr<const ArrayDoubleN> scalar;
+    Rectangle<double> extent = Rectangle<double> (0.0, 0.0, 1.0, 1.0);
     double        vmin = 0.0;
     double        vmax = 1.0;
     ColourMap     colorMap;
+    Image         image;
+
+    /** Map the values to colours through the colour map, or to shades of grey
+        if it is empty, and store the result in image.
+     */
+    void createImage();
+
+    //==========================================================================
+    std::string type() const override { return "ImagePlotModel"; }
+    std::string describe() const override { return "ImagePlotModel"; }
+    std::string serialize() const override { return ""; }
+    bool load (const std::string&) override { return false; }
 };
 
 
@@ -161,5 +227,6 @@ public:
 
     static Object::Dict plot_models();
     static Object line_plot (const Object::List&, const Object::Dict&);
+    static Object image_plot (const Object::List&, const Object::Dict&);
     static Object figure (const Object::List&, const Object::Dict&);
 };